@@ -0,0 +1,107 @@
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "libchess/Position.h"
+
+#include "search.h"
+#include "tt.h"
+
+using namespace libchess;
+
+// Fails if a fixed-depth search touches the heap. Every global allocation function is replaced
+// with one that counts calls while counting is switched on around the measured searches.
+
+namespace {
+
+std::atomic<bool> counting{false};
+std::atomic<std::uint64_t> allocations{0};
+
+void* allocate(std::size_t size) {
+    if (counting) {
+        ++allocations;
+    }
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void* allocate_aligned(std::size_t size, std::align_val_t alignment) {
+    if (counting) {
+        ++allocations;
+    }
+    auto align = static_cast<std::size_t>(alignment);
+    if (void* ptr = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+} // namespace
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return allocate_aligned(size, alignment);
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return allocate_aligned(size, alignment);
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+
+namespace {
+
+// Quiet, tactical, promotion and in-check positions so every search path is exercised
+const std::vector<std::string> POSITIONS{{
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+}};
+
+const int SEARCH_DEPTH = 6;
+
+} // namespace
+
+int main() {
+    std::uint64_t total = 0;
+    for (auto& fen : POSITIONS) {
+        Position pos = *Position::from_fen(fen);
+        auto search_globals = search::SearchGlobals::new_search_globals();
+        search_globals.set_depth_limit(SEARCH_DEPTH);
+        search_globals.set_iteration_handler(
+            [](int, int, std::uint64_t, std::chrono::milliseconds, const MoveList&) {});
+
+        // The warm-up search lets one-time initialisation (statics, thread-local state, stream
+        // buffers) happen before anything is counted
+        tt.clear();
+        search::best_move_search(pos, search_globals);
+
+        tt.clear();
+        allocations = 0;
+        counting = true;
+        search::best_move_search(pos, search_globals);
+        counting = false;
+
+        std::cout << allocations << " allocations in " << fen << "\n";
+        total += allocations;
+    }
+    if (total) {
+        std::cout << "FAILED: the search allocated " << total << " times\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+
+#include "libchess/Position.h"
+
+namespace book {
+
+std::uint64_t polyglot_key(const libchess::Position& pos);
+
+// Polyglot opening book backed by a read-only memory mapping of the .bin file, so opening a
+// book costs the same regardless of its size and pages are only faulted in when probed.
+class Book {
+  public:
+    Book() noexcept = default;
+    ~Book() { close(); }
+    Book(const Book&) = delete;
+    Book& operator=(const Book&) = delete;
+
+    bool open(const std::string& path);
+    void close() noexcept;
+    [[nodiscard]] bool is_open() const noexcept { return data_ != nullptr; }
+
+    void set_enabled(bool enabled) noexcept { enabled_ = enabled; }
+    void set_best_move(bool best_move) noexcept { best_move_ = best_move; }
+    [[nodiscard]] bool enabled() const noexcept { return enabled_ && is_open(); }
+
+    std::optional<libchess::Move> probe(const libchess::Position& pos);
+
+  private:
+    const unsigned char* data_ = nullptr;
+    std::size_t length_ = 0;
+    std::size_t num_entries_ = 0;
+    bool enabled_ = false;
+    bool best_move_ = false;
+    std::mt19937_64 rng_{std::random_device{}()};
+};
+
+} // namespace book
+
+#endif // BOOK_H
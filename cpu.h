@@ -0,0 +1,69 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <optional>
+#include <string>
+
+namespace cpu {
+
+// Instruction set levels the hot bitboard kernels are compiled for. BMI2 also implies
+// POPCNT and BMI1 (TZCNT).
+enum class Variant { GENERIC, POPCNT, BMI2 };
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_DISPATCH 1
+#define CPU_TARGET_POPCNT __attribute__((target("popcnt")))
+#define CPU_TARGET_BMI2 __attribute__((target("popcnt,bmi,bmi2")))
+#else
+#define CPU_DISPATCH 0
+#endif
+
+inline bool supports(Variant variant) {
+#if CPU_DISPATCH
+    __builtin_cpu_init();
+    switch (variant) {
+    case Variant::BMI2:
+        return __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("bmi") &&
+               __builtin_cpu_supports("bmi2");
+    case Variant::POPCNT:
+        return __builtin_cpu_supports("popcnt");
+    default:
+        return true;
+    }
+#else
+    return variant == Variant::GENERIC;
+#endif
+}
+
+inline Variant best_variant() {
+    if (supports(Variant::BMI2)) {
+        return Variant::BMI2;
+    } else if (supports(Variant::POPCNT)) {
+        return Variant::POPCNT;
+    }
+    return Variant::GENERIC;
+}
+
+inline const char* variant_name(Variant variant) {
+    switch (variant) {
+    case Variant::BMI2:
+        return "bmi2";
+    case Variant::POPCNT:
+        return "popcnt";
+    default:
+        return "generic";
+    }
+}
+
+inline std::optional<Variant> variant_from_name(const std::string& name) {
+    for (auto variant : {Variant::GENERIC, Variant::POPCNT, Variant::BMI2}) {
+        if (name == variant_name(variant)) {
+            return variant;
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace cpu
+
+#endif // CPU_H
@@ -0,0 +1,334 @@
+#include "datagen.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "libchess/Position.h"
+
+#include "repetition.h"
+#include "search.h"
+#include "tt.h"
+
+using namespace libchess;
+
+namespace datagen {
+
+namespace {
+
+const char DATAGEN_FILE_MAGIC[8] = {'L', 'C', 'E', 'D', 'A', 'T', 'A', '\0'};
+const std::uint32_t DATAGEN_FILE_VERSION = 1;
+
+// Indexed by piece type, matching the nibbles of PackedPosition
+const std::string PIECE_CHARS = "pnbrqk";
+const std::string CASTLING_CHARS = "KQkq";
+
+DatagenFileHeader make_file_header() {
+    return {fileformat::make_header(DATAGEN_FILE_MAGIC, DATAGEN_FILE_VERSION,
+                                    sizeof(PackedPosition))};
+}
+
+bool is_valid_file_header(const DatagenFileHeader& header) {
+    return fileformat::is_valid_header(header.format, DATAGEN_FILE_MAGIC, DATAGEN_FILE_VERSION,
+                                       sizeof(PackedPosition));
+}
+
+struct Sample {
+    std::string fen;
+    int score;
+};
+
+bool is_capture(const Position& pos, Move move) {
+    return pos.piece_type_on(move.to_square()) || move.type() == Move::Type::ENPASSANT ||
+           move.promotion_piece_type();
+}
+
+// Plays out a random opening of the given length, returning false if the game ends during it
+bool play_random_opening(Position& pos, repetition::GameHistory& history, int plies,
+                         std::mt19937_64& rng) {
+    for (int ply = 0; ply < plies; ++ply) {
+        auto move_list = pos.legal_move_list();
+        if (move_list.empty()) {
+            return false;
+        }
+        std::uniform_int_distribution<std::size_t> distribution{0, move_list.size() - 1};
+        pos.make_move(*std::next(move_list.begin(), distribution(rng)));
+        history.push(pos.hash());
+    }
+    return !pos.legal_move_list().empty();
+}
+
+// Plays one game and returns its samples along with the result for white
+std::pair<std::vector<Sample>, double> play_game(const DatagenConfig& config,
+                                                 TranspositionTable& table, std::mt19937_64& rng) {
+    Position pos{constants::STARTPOS_FEN};
+    repetition::GameHistory history;
+    history.push(pos.hash());
+    std::vector<Sample> samples;
+    if (!play_random_opening(pos, history, config.random_plies, rng)) {
+        return {samples, 0.5};
+    }
+
+    auto search_globals = search::SearchGlobals::new_search_globals();
+    search_globals.set_node_limit(config.nodes);
+    search_globals.set_transposition_table(&table);
+    int score = 0;
+    search_globals.set_iteration_handler(
+        [&score](int, int iteration_score, std::uint64_t, std::chrono::milliseconds,
+                 const MoveList&) { score = iteration_score; });
+
+    int decisive_plies = 0;
+    for (int ply = 0; ply < config.max_plies; ++ply) {
+        int white_score_sign = pos.side_to_move() == constants::WHITE ? 1 : -1;
+        if (pos.legal_move_list().empty()) {
+            return {samples, pos.in_check() ? (white_score_sign > 0 ? 0.0 : 1.0) : 0.5};
+        }
+        if (pos.halfmoves() >= 100 || history.is_threefold(pos.halfmoves()) ||
+            pos.occupancy_bb().popcount() == 2) {
+            return {samples, 0.5};
+        }
+
+        auto best_move = search::best_move_search(pos, search_globals);
+        if (!best_move) {
+            return {samples, 0.5};
+        }
+
+        // Only quiet positions are useful to the tuner: skip checks and tactical best moves
+        if (!pos.in_check() && !is_capture(pos, *best_move) &&
+            std::abs(score) < search::MAX_MATE_SCORE) {
+            samples.push_back({pos.fen(), score * white_score_sign});
+        }
+
+        decisive_plies = std::abs(score) >= config.adjudicate_score ? decisive_plies + 1 : 0;
+        if (decisive_plies >= config.adjudicate_plies) {
+            return {samples, score * white_score_sign > 0 ? 1.0 : 0.0};
+        }
+
+        pos.make_move(*best_move);
+        history.push(pos.hash());
+    }
+    return {samples, 0.5};
+}
+
+} // namespace
+
+std::optional<PackedPosition> pack_position(const std::string& fen, int score, double result) {
+    std::istringstream fen_stream{fen};
+    std::string board, side, castling, enpassant;
+    int halfmoves = 0;
+    int fullmoves = 1;
+    if (!(fen_stream >> board >> side >> castling >> enpassant)) {
+        return std::nullopt;
+    }
+    fen_stream >> halfmoves >> fullmoves;
+
+    std::array<int, 64> squares;
+    squares.fill(-1);
+    int rank = 7;
+    int file = 0;
+    for (char c : board) {
+        if (c == '/') {
+            --rank;
+            file = 0;
+        } else if (c >= '1' && c <= '8') {
+            file += c - '0';
+        } else {
+            auto piece_type = PIECE_CHARS.find(char(std::tolower(c)));
+            if (piece_type == std::string::npos || rank < 0 || file > 7) {
+                return std::nullopt;
+            }
+            int color = std::isupper(c) ? 0 : 1;
+            squares[rank * 8 + file++] = (color << 3) | int(piece_type);
+        }
+    }
+
+    PackedPosition packed{};
+    int count = 0;
+    for (int square = 0; square < 64; ++square) {
+        if (squares[square] < 0) {
+            continue;
+        }
+        if (count == 32) {
+            return std::nullopt;
+        }
+        packed.occupancy |= 1ULL << unsigned(square);
+        packed.pieces[count / 2] |= std::uint8_t(squares[square] << (4 * (count % 2)));
+        ++count;
+    }
+
+    packed.flags = side == "b" ? 1 : 0;
+    for (char c : castling) {
+        auto right = CASTLING_CHARS.find(c);
+        if (right != std::string::npos) {
+            packed.flags |= std::uint8_t(1U << (right + 1));
+        }
+    }
+    packed.enpassant_file = enpassant == "-" ? 8 : std::uint8_t(enpassant[0] - 'a');
+    packed.halfmoves = std::uint8_t(std::clamp(halfmoves, 0, 255));
+    packed.fullmoves = std::uint16_t(std::clamp(fullmoves, 1, 65535));
+    packed.score = std::int16_t(std::clamp(score, -32767, 32767));
+    packed.result = std::uint8_t(std::lround(result * 2));
+    return packed;
+}
+
+std::string unpack_fen(const PackedPosition& position) {
+    std::string fen;
+    for (int rank = 7; rank >= 0; --rank) {
+        int empty = 0;
+        for (int file = 0; file < 8; ++file) {
+            int square = rank * 8 + file;
+            if (!(position.occupancy >> unsigned(square) & 1U)) {
+                ++empty;
+                continue;
+            }
+            if (empty) {
+                fen += char('0' + empty);
+                empty = 0;
+            }
+            int index = __builtin_popcountll(position.occupancy & ((1ULL << unsigned(square)) - 1));
+            int piece = (position.pieces[index / 2] >> (4 * (index % 2))) & 0xF;
+            char c = PIECE_CHARS[std::size_t(piece & 7)];
+            fen += piece >> 3 ? c : char(std::toupper(c));
+        }
+        if (empty) {
+            fen += char('0' + empty);
+        }
+        if (rank) {
+            fen += '/';
+        }
+    }
+
+    bool black = position.flags & 1U;
+    fen += black ? " b " : " w ";
+    std::string castling;
+    for (std::size_t right = 0; right < CASTLING_CHARS.size(); ++right) {
+        if (position.flags >> (right + 1) & 1U) {
+            castling += CASTLING_CHARS[right];
+        }
+    }
+    fen += castling.empty() ? "-" : castling;
+    if (position.enpassant_file < 8) {
+        fen += std::string{" "} + char('a' + position.enpassant_file) + (black ? "3" : "6");
+    } else {
+        fen += " -";
+    }
+    return fen + " " + std::to_string(position.halfmoves) + " " +
+           std::to_string(position.fullmoves);
+}
+
+double unpack_result(const PackedPosition& position) { return position.result / 2.0; }
+
+std::optional<std::vector<PackedPosition>> read_file(const std::string& path) {
+    std::ifstream in{path, std::ios::binary};
+    DatagenFileHeader header{};
+    if (!in || !in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        !is_valid_file_header(header)) {
+        return std::nullopt;
+    }
+    std::vector<PackedPosition> positions;
+    PackedPosition position{};
+    while (in.read(reinterpret_cast<char*>(&position), sizeof(position))) {
+        positions.push_back(position);
+    }
+    return positions;
+}
+
+void run(const DatagenConfig& config) {
+    // Positions are appended to an existing file only if it was written in the same format
+    bool empty;
+    {
+        std::ifstream existing{config.output_path, std::ios::binary};
+        empty = !existing || existing.peek() == std::ifstream::traits_type::eof();
+        DatagenFileHeader header{};
+        if (!empty && (!existing.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+                       !is_valid_file_header(header))) {
+            std::cout << config.output_path << " is not a datagen file\n";
+            return;
+        }
+    }
+    std::ofstream output{config.output_path, std::ios::binary | std::ios::app};
+    if (!output) {
+        std::cout << "Unable to open " << config.output_path << "\n";
+        return;
+    }
+    if (empty) {
+        DatagenFileHeader header = make_file_header();
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+
+    std::uint64_t seed = [&config]() {
+        if (config.seed) {
+            return *config.seed;
+        }
+        std::random_device random_device;
+        return (std::uint64_t(random_device()) << 32U) | random_device();
+    }();
+    std::cout << "Seed " << seed << "\n";
+
+    std::mutex output_mutex;
+    std::atomic<std::uint64_t> next_game{0};
+    std::uint64_t games_done = 0;
+    std::uint64_t positions_written = 0;
+    auto start_time = std::chrono::steady_clock::now();
+    auto report = [&]() {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start_time);
+        std::cout << "Games " << games_done << ", positions " << positions_written << ", "
+                  << positions_written * 1000 / std::max<std::uint64_t>(elapsed.count(), 1)
+                  << " positions/s\n";
+    };
+
+    auto worker = [&]() {
+        // A table per worker, cleared before each game, keeps a game independent of the games
+        // played before it and on other threads
+        TranspositionTable table{config.hash_mb};
+        std::uint64_t game;
+        while ((game = next_game++) < config.games) {
+            table.clear();
+            std::seed_seq seed_sequence{std::uint32_t(seed), std::uint32_t(seed >> 32U),
+                                        std::uint32_t(game), std::uint32_t(game >> 32U)};
+            std::mt19937_64 rng{seed_sequence};
+            auto [samples, result] = play_game(config, table, rng);
+
+            std::string records;
+            std::uint64_t packed_count = 0;
+            for (auto& sample : samples) {
+                if (auto packed = pack_position(sample.fen, sample.score, result)) {
+                    records.append(reinterpret_cast<const char*>(&*packed), sizeof(*packed));
+                    ++packed_count;
+                }
+            }
+
+            std::lock_guard<std::mutex> lock{output_mutex};
+            output.write(records.data(), std::streamsize(records.size()));
+            positions_written += packed_count;
+            if (++games_done % 100 == 0) {
+                output.flush();
+                report();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < std::max(config.threads, 1); ++i) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    report();
+}
+
+} // namespace datagen
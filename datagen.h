@@ -0,0 +1,66 @@
+#ifndef DATAGEN_H
+#define DATAGEN_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "fileformat.h"
+
+namespace datagen {
+
+struct DatagenConfig {
+    std::string output_path;
+    int threads = 1;
+    std::uint64_t games = 1000;
+    std::uint64_t nodes = 5000;
+    int random_plies = 8;
+    int max_plies = 400;
+    int adjudicate_score = 2000;
+    int adjudicate_plies = 8;
+    // Size of the hash table each worker searches with
+    int hash_mb = 16;
+    // Game n is played from a generator seeded with (seed, n), so any game can be replayed. A
+    // random seed is chosen and printed when none is given.
+    std::optional<std::uint64_t> seed;
+};
+
+// One position in 32 bytes. Pieces are listed in square order from a1, one nibble each holding
+// (color << 3) | piece type for every set bit of occupancy. flags holds the side to move in bit 0
+// and the KQkq castling rights in bits 1 to 4, and enpassant_file is 8 when there is no en
+// passant square. Scores are from white's point of view and results are 0, 1 or 2 for a black
+// win, a draw or a white win.
+struct PackedPosition {
+    std::uint64_t occupancy;
+    std::uint8_t pieces[16];
+    std::uint16_t fullmoves;
+    std::int16_t score;
+    std::uint8_t flags;
+    std::uint8_t enpassant_file;
+    std::uint8_t halfmoves;
+    std::uint8_t result;
+};
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition must be 32 bytes");
+
+// Header at the start of a datagen file, which is followed by PackedPosition records
+struct DatagenFileHeader {
+    fileformat::Header format;
+};
+
+std::optional<PackedPosition> pack_position(const std::string& fen, int score, double result);
+std::string unpack_fen(const PackedPosition& position);
+// The game result for white as 1.0, 0.5 or 0.0
+double unpack_result(const PackedPosition& position);
+
+// Reads every position of a file written by run(), or returns nothing if path is not one
+std::optional<std::vector<PackedPosition>> read_file(const std::string& path);
+
+// Plays fixed-node self-play games from randomised openings on a pool of threads and appends the
+// quiet positions of each game to output_path as PackedPosition records. Each worker searches
+// with its own hash table, cleared before every game, so a game depends only on its seed.
+void run(const DatagenConfig& config);
+
+} // namespace datagen
+
+#endif // DATAGEN_H
@@ -8,7 +8,9 @@ int tapered_score(std::array<int, 2> score, int phase) {
     return ((score[MIDGAME] * phase) + (score[ENDGAME] * (MAX_PHASE - phase))) / MAX_PHASE;
 }
 
-int evaluate(const Position& pos) {
+// Shared body of every evaluate() variant. It is force-inlined so each variant compiles it, and the
+// inlined libchess popcount/bitscan helpers, for its own instruction set.
+[[gnu::always_inline]] inline int evaluate_impl(const Position& pos) {
     std::array<int, 2> score{0, 0};
 
     Bitboard pawn_bb = pos.piece_type_bb(constants::PAWN);
@@ -22,9 +24,11 @@ int evaluate(const Position& pos) {
             // Phase
             phase += num_piece * PIECE_PHASE[piece_type];
 
-            // Material
-            score[MIDGAME] += num_piece * MATERIAL[piece_type][MIDGAME];
-            score[ENDGAME] += num_piece * MATERIAL[piece_type][ENDGAME];
+            // Material, unless already folded into the piece square tables
+            if constexpr (!PSQT_HAS_MATERIAL) {
+                score[MIDGAME] += num_piece * MATERIAL[piece_type][MIDGAME];
+                score[ENDGAME] += num_piece * MATERIAL[piece_type][ENDGAME];
+            }
 
             // Piece Square Tables
             Bitboard bb = piece_bb;
@@ -85,4 +89,48 @@ int evaluate(const Position& pos) {
     return eval;
 }
 
+int evaluate_generic(const Position& pos) { return evaluate_impl(pos); }
+
+#if CPU_DISPATCH
+CPU_TARGET_POPCNT int evaluate_popcnt(const Position& pos) { return evaluate_impl(pos); }
+
+CPU_TARGET_BMI2 int evaluate_bmi2(const Position& pos) { return evaluate_impl(pos); }
+#endif
+
+namespace {
+
+using EvaluateFunction = int (*)(const Position&);
+
+EvaluateFunction evaluate_function(cpu::Variant variant) {
+#if CPU_DISPATCH
+    switch (variant) {
+    case cpu::Variant::BMI2:
+        return evaluate_bmi2;
+    case cpu::Variant::POPCNT:
+        return evaluate_popcnt;
+    default:
+        break;
+    }
+#endif
+    return evaluate_generic;
+}
+
+cpu::Variant selected_variant = cpu::best_variant();
+EvaluateFunction selected_evaluate = evaluate_function(selected_variant);
+
+} // namespace
+
+bool set_cpu_variant(cpu::Variant variant) {
+    if (!cpu::supports(variant)) {
+        return false;
+    }
+    selected_variant = variant;
+    selected_evaluate = evaluate_function(variant);
+    return true;
+}
+
+cpu::Variant cpu_variant() { return selected_variant; }
+
+int evaluate(const Position& pos) { return selected_evaluate(pos); }
+
 } // namespace eval
@@ -3,7 +3,10 @@
 
 #include "libchess/Position.h"
 
+#include "cpu.h"
+
 #include <array>
+#include <vector>
 
 namespace eval {
 
@@ -13,26 +16,71 @@ inline const int MAX_PHASE = 256;
 
 inline const std::array<int, 6> PIECE_PHASE{{1, 10, 10, 20, 40, 0}};
 
-inline std::array<std::array<int, 2>, 6> MATERIAL{{
-    {147, 116},
-    {378, 518},
-    {414, 547},
-    {741, 658},
-    {1335, 1474},
-    {0, 0},
+// Evaluation weights are Parameters. In a release build they are constexpr so the compiler folds
+// them into evaluate(). With TUNE defined they are mutable and each one adds itself to
+// parameter_registry() under its name, which the tuner and setoption work from.
+#ifdef TUNE
+#define TUNABLE inline
+
+struct RegisteredParameter {
+    const char* name;
+    int* value;
+};
+
+inline std::vector<RegisteredParameter>& parameter_registry() {
+    static std::vector<RegisteredParameter> registry;
+    return registry;
+}
+
+class Parameter {
+  public:
+    Parameter(int value) : value_(value) {}
+    Parameter(const char* name, int value) : value_(value) {
+        parameter_registry().push_back({name, &value_});
+    }
+    Parameter(const Parameter&) = delete;
+    Parameter& operator=(const Parameter&) = delete;
+
+    operator int() const { return value_; }
+
+  private:
+    int value_;
+};
+#else
+#define TUNABLE inline constexpr
+
+class Parameter {
+  public:
+    constexpr Parameter(int value) : value_(value) {}
+    constexpr Parameter(const char*, int value) : value_(value) {}
+
+    constexpr operator int() const { return value_; }
+
+  private:
+    int value_;
+};
+#endif
+
+TUNABLE std::array<std::array<Parameter, 2>, 6> MATERIAL{{
+    {{{"PawnMG", 147}, {"PawnEG", 116}}},
+    {{{"KnightMG", 378}, {"KnightEG", 518}}},
+    {{{"BishopMG", 414}, {"BishopEG", 547}}},
+    {{{"RookMG", 741}, {"RookEG", 658}}},
+    {{{"QueenMG", 1335}, {"QueenEG", 1474}}},
+    {{0, 0}},
 }};
 
-inline int ROOK_7TH_RANK_MG = 101;
-inline int ROOK_7TH_RANK_EG = -3;
+TUNABLE Parameter ROOK_7TH_RANK_MG{"Rook7thRankMG", 101};
+TUNABLE Parameter ROOK_7TH_RANK_EG{"Rook7thRankEG", -3};
 
-inline int DOUBLED_PAWNS_MG = -13;
-inline int DOUBLED_PAWNS_EG = -43;
+TUNABLE Parameter DOUBLED_PAWNS_MG{"DoubledPawnMG", -13};
+TUNABLE Parameter DOUBLED_PAWNS_EG{"DoubledPawnEG", -43};
 
-inline int ISOLATED_PAWNS_MG = -31;
-inline int ISOLATED_PAWNS_EG = -5;
+TUNABLE Parameter ISOLATED_PAWNS_MG{"IsolatedPawnMG", -31};
+TUNABLE Parameter ISOLATED_PAWNS_EG{"IsolatedPawnEG", -5};
 
 // clang-format off
-inline std::array<std::array<std::array<int, 2>, 32>, 6> PSQT_TMP = {
+inline constexpr std::array<std::array<std::array<int, 2>, 32>, 6> PSQT_TMP = {
     {{{	// Pawn
           {  0,   0}, {  0,   0}, {  0,   0}, {  0,   0},
           {  0,   0}, {  0,   0}, {  0,   0}, {  0,   0},
@@ -98,8 +146,19 @@ inline std::array<std::array<std::array<int, 2>, 32>, 6> PSQT_TMP = {
     }};
 // clang-format on
 
-inline const std::array<std::array<std::array<std::array<int, 2>, 64>, 6>, 2> PSQT = []() {
-    std::array<std::array<std::array<std::array<int, 2>, 64>, 6>, 2> psqt{};
+// Material is folded into the piece-square table whenever it is a compile-time constant, so
+// evaluate() only has to add the table entries up. A TUNE build keeps the two apart and adds
+// material from MATERIAL at runtime so that tuned values take effect.
+#ifdef TUNE
+inline constexpr bool PSQT_HAS_MATERIAL = false;
+#else
+inline constexpr bool PSQT_HAS_MATERIAL = true;
+#endif
+
+using PSQTable = std::array<std::array<std::array<std::array<int, 2>, 64>, 6>, 2>;
+
+inline constexpr PSQTable make_psqt() {
+    PSQTable psqt{};
     for (int c = 0; c < 2; ++c) {
         int k = 0;
         for (int rank = 0; rank < 8; ++rank) {
@@ -111,18 +170,34 @@ inline const std::array<std::array<std::array<std::array<int, 2>, 64>, 6>, 2> PS
                     sq2 ^= 56;
                 }
                 for (int pt = 0; pt < 6; ++pt) {
-                    psqt[c][pt][sq1] = psqt[c][pt][sq2] = PSQT_TMP[pt][k];
-                    psqt[c][pt][sq1] = psqt[c][pt][sq2] = PSQT_TMP[pt][k];
+                    for (int stage = MIDGAME; stage <= ENDGAME; ++stage) {
+                        int value = PSQT_TMP[pt][k][stage];
+                        if constexpr (PSQT_HAS_MATERIAL) {
+                            value += MATERIAL[pt][stage];
+                        }
+                        psqt[c][pt][sq1][stage] = psqt[c][pt][sq2][stage] = value;
+                    }
                 }
                 ++k;
             }
         }
     }
     return psqt;
-}();
+}
+
+#ifdef TUNE
+inline const PSQTable PSQT = make_psqt();
+#else
+inline constexpr PSQTable PSQT = make_psqt();
+#endif
 
 int evaluate(const libchess::Position&);
 
+// Selects which instruction set variant evaluate() runs. The best one the CPU supports is chosen
+// at startup; returns false if the CPU lacks the requested variant.
+bool set_cpu_variant(cpu::Variant variant);
+cpu::Variant cpu_variant();
+
 } // namespace eval
 
 #endif // EVALUATION_H
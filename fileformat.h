@@ -0,0 +1,41 @@
+#ifndef FILEFORMAT_H
+#define FILEFORMAT_H
+
+#include <cstdint>
+#include <cstring>
+
+namespace fileformat {
+
+// Start of every binary file the engine writes, ahead of the format's own header fields. The
+// files hold raw structs, so a reader also checks the record size and the byte order:
+// BYTE_ORDER_MARK reads back as a different value on a machine of the other endianness.
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t record_size;
+    std::uint64_t byte_order;
+};
+static_assert(sizeof(Header) == 24, "fileformat::Header must be 24 bytes");
+
+inline const std::uint64_t BYTE_ORDER_MARK = 0x0102030405060708;
+
+inline Header make_header(const char (&magic)[8], std::uint32_t version,
+                          std::uint32_t record_size) {
+    Header header{};
+    std::memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = version;
+    header.record_size = record_size;
+    header.byte_order = BYTE_ORDER_MARK;
+    return header;
+}
+
+inline bool is_valid_header(const Header& header, const char (&magic)[8], std::uint32_t version,
+                            std::uint32_t record_size) {
+    return std::memcmp(header.magic, magic, sizeof(header.magic)) == 0 &&
+           header.version == version && header.record_size == record_size &&
+           header.byte_order == BYTE_ORDER_MARK;
+}
+
+} // namespace fileformat
+
+#endif // FILEFORMAT_H
@@ -1,19 +1,142 @@
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "libchess/Position.h"
 #include "libchess/UCIService.h"
 
+#include "book.h"
+#include "datagen.h"
+#include "match.h"
+#include "mate.h"
 #include "search.h"
+#include "testsuite.h"
+#include "trace.h"
+#include "tt.h"
 #include "tune.h"
 
 using namespace libchess;
 
-int main() {
+int testsuite_main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "Usage: " << argv[0]
+                  << " testsuite <epd> [--nodes N] [--movetime MS] [--record <epd>]\n";
+        return -1;
+    }
+    std::optional<std::uint64_t> nodes;
+    std::optional<std::chrono::milliseconds> move_time;
+    std::string record_path;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--record") {
+            record_path = argv[i + 1];
+        } else if (arg == "--nodes") {
+            nodes = std::stoull(argv[i + 1]);
+        } else if (arg == "--movetime") {
+            move_time = std::chrono::milliseconds{std::stoll(argv[i + 1])};
+        }
+    }
+    if (!nodes && !move_time) {
+        nodes = 1000000;
+    }
+    return testsuite::run(argv[2], nodes, move_time, record_path);
+}
+
+int match_main(int argc, char* argv[]) {
+    match::MatchConfig config;
+    config.engines[0].path = config.engines[1].path = match::self_path(argv[0]);
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+        if (arg == "--engine1" || arg == "--engine2") {
+            config.engines[arg == "--engine1" ? 0 : 1].path = value;
+        } else if (arg == "--option1" || arg == "--option2") {
+            auto separator = value.find('=');
+            if (separator != std::string::npos) {
+                config.engines[arg == "--option1" ? 0 : 1].options.emplace_back(
+                    value.substr(0, separator), value.substr(separator + 1));
+            }
+        } else if (arg == "--openings") {
+            config.openings_path = value;
+        } else if (arg == "--games") {
+            config.max_games = std::stoi(value);
+        } else if (arg == "--concurrency") {
+            config.concurrency = std::stoi(value);
+        } else if (arg == "--nodes") {
+            config.nodes = std::stoull(value);
+        } else if (arg == "--tc") {
+            auto separator = value.find('+');
+            config.base_time_ms = std::stoi(value.substr(0, separator));
+            config.increment_ms =
+                separator == std::string::npos ? 0 : std::stoi(value.substr(separator + 1));
+        } else if (arg == "--elo0") {
+            config.elo0 = std::stod(value);
+        } else if (arg == "--elo1") {
+            config.elo1 = std::stod(value);
+        }
+    }
+    if (config.openings_path.empty()) {
+        std::cout << "Usage: " << argv[0]
+                  << " match --openings <epd> [--engine1 <path>] [--engine2 <path>]"
+                     " [--option1 name=value] [--option2 name=value] [--games N]"
+                     " [--concurrency N] [--nodes N | --tc base_ms+inc_ms]"
+                     " [--elo0 elo] [--elo1 elo]\n";
+        return 2;
+    }
+    return match::run(config);
+}
+
+int datagen_main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "Usage: " << argv[0]
+                  << " datagen <output> [--threads N] [--games N] [--nodes N]"
+                     " [--random-plies N] [--hash MB] [--seed N]\n";
+        return 1;
+    }
+    datagen::DatagenConfig config;
+    config.output_path = argv[2];
+    config.threads = int(std::max(std::thread::hardware_concurrency(), 1U));
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+        if (arg == "--threads") {
+            config.threads = std::stoi(value);
+        } else if (arg == "--games") {
+            config.games = std::stoull(value);
+        } else if (arg == "--nodes") {
+            config.nodes = std::stoull(value);
+        } else if (arg == "--random-plies") {
+            config.random_plies = std::stoi(value);
+        } else if (arg == "--hash") {
+            config.hash_mb = std::stoi(value);
+        } else if (arg == "--seed") {
+            config.seed = std::stoull(value);
+        }
+    }
+    datagen::run(config);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
     std::ios_base::sync_with_stdio(false);
     std::cout.setf(std::ios::unitbuf);
 
+    if (argc > 1 && std::string{argv[1]} == "testsuite") {
+        return testsuite_main(argc, argv) == 0 ? 0 : 1;
+    }
+    if (argc > 1 && std::string{argv[1]} == "match") {
+        return match_main(argc, argv);
+    }
+    if (argc > 1 && std::string{argv[1]} == "datagen") {
+        return datagen_main(argc, argv);
+    }
+
     Position position{constants::STARTPOS_FEN};
     search::SearchGlobals search_globals = search::SearchGlobals::new_search_globals();
+    book::Book opening_book;
     auto position_handler = [&position](const UCIPositionParameters& position_parameters) {
         position = Position{position_parameters.fen()};
         if (!position_parameters.move_list()) {
@@ -23,9 +146,20 @@ int main() {
             position.make_move(*Move::from(move_str));
         }
     };
-    auto go_handler = [&position, &search_globals](const UCIGoParameters& go_parameters) {
+    auto go_handler = [&position, &search_globals,
+                       &opening_book](const UCIGoParameters& go_parameters) {
+        // Infinite and ponder searches must wait for stop, and go mate asks for a proof
+        bool book_allowed =
+            !go_parameters.infinite() && !go_parameters.ponder() && !go_parameters.mate();
+        auto book_move = book_allowed ? opening_book.probe(position) : std::nullopt;
+        if (book_move) {
+            UCIService::bestmove(book_move->to_str());
+            return;
+        }
         search_globals.set_go_parameters(go_parameters);
-        auto best_move = search::best_move_search(position, search_globals);
+        auto best_move = go_parameters.mate()
+                             ? mate::mate_search(position, *go_parameters.mate(), search_globals)
+                             : search::best_move_search(position, search_globals);
         if (best_move) {
             UCIService::bestmove(best_move->to_str());
         } else {
@@ -34,13 +168,95 @@ int main() {
     };
     auto stop_handler = [&search_globals]() { search_globals.set_stop_flag(true); };
     auto display_handler = [&position](const std::istringstream&) { position.display(); };
+    auto savehash_handler = [](std::istringstream& line_stream) {
+        std::string path;
+        line_stream >> std::quoted(path);
+        if (!tt.save(path)) {
+            std::cout << "info string Unable to save hash to " << path << "\n";
+        }
+    };
+    auto loadhash_handler = [](std::istringstream& line_stream) {
+        std::string path;
+        line_stream >> std::quoted(path);
+        if (!tt.load(path)) {
+            std::cout << "info string Unable to load hash from " << path << "\n";
+        }
+    };
 
-    UCIService uci_service{"LibchessEngine", "Manik Charan"};
+    UCIService uci_service{std::string{"LibchessEngine ("} +
+                               cpu::variant_name(eval::cpu_variant()) + ")",
+                           "Manik Charan"};
     uci_service.register_position_handler(position_handler);
     uci_service.register_go_handler(go_handler);
     uci_service.register_stop_handler(stop_handler);
     uci_service.register_handler("d", display_handler);
+#ifdef TUNE
     uci_service.register_handler("tune", tune_handler);
+    for (auto& param : eval::parameter_registry()) {
+        uci_service.register_option(UCISpinOption{param.name, *param.value, -10000, 10000,
+                                                  [value = param.value](int v) { *value = v; }});
+    }
+#endif
+    uci_service.register_handler("savehash", savehash_handler);
+#ifdef SEARCH_TRACE
+    uci_service.register_handler("tracedump", [](std::istringstream& line_stream) {
+        std::string path;
+        line_stream >> std::quoted(path);
+        if (!trace::dump(path)) {
+            std::cout << "info string Unable to write trace to " << path << "\n";
+        }
+    });
+#endif
+    uci_service.register_handler("loadhash", loadhash_handler);
+    // A HashShared segment stays in /dev/shm after every engine using it has exited; this removes
+    // it so that it can be freed or recreated with a different size
+    uci_service.register_handler("unlinkhash", [](std::istringstream& line_stream) {
+        std::string name;
+        line_stream >> std::quoted(name);
+        if (name.empty() || !TranspositionTable::unlink_shared(name)) {
+            std::cout << "info string Unable to unlink shared hash " << name << "\n";
+        }
+    });
+    uci_service.register_option(UCIStringOption{"HashFile", "", [](const std::string& path) {
+        if (path.empty()) {
+            tt.resize(128);
+        } else if (!tt.map_file(path, 128)) {
+            std::cout << "info string Unable to map hash file " << path << "\n";
+        }
+    }});
+    std::vector<std::string> variant_names;
+    for (auto variant : {cpu::Variant::GENERIC, cpu::Variant::POPCNT, cpu::Variant::BMI2}) {
+        variant_names.emplace_back(cpu::variant_name(variant));
+    }
+    uci_service.register_option(UCIComboOption{
+        "CPUVariant", cpu::variant_name(eval::cpu_variant()), variant_names,
+        [](const std::string& name) {
+            auto variant = cpu::variant_from_name(name);
+            if (!variant || !eval::set_cpu_variant(*variant)) {
+                std::cout << "info string CPU variant " << name << " is not supported\n";
+            }
+            std::cout << "info string Using " << cpu::variant_name(eval::cpu_variant())
+                      << " kernels\n";
+        }});
+    uci_service.register_option(UCIStringOption{"HashShared", "", [](const std::string& name) {
+        if (name.empty()) {
+            tt.resize(128);
+        } else if (!tt.map_shared(name, 128)) {
+            std::cout << "info string Unable to map shared hash " << name << "\n";
+        }
+    }});
+    uci_service.register_option(UCICheckOption{
+        "OwnBook", false, [&opening_book](bool value) { opening_book.set_enabled(value); }});
+    uci_service.register_option(UCIStringOption{
+        "Book", "", [&opening_book](const std::string& path) {
+            if (path.empty()) {
+                opening_book.close();
+            } else if (!opening_book.open(path)) {
+                std::cout << "info string Unable to open book " << path << "\n";
+            }
+        }});
+    uci_service.register_option(UCICheckOption{
+        "BookBestMove", false, [&opening_book](bool value) { opening_book.set_best_move(value); }});
 
     std::string line;
     while (true) {
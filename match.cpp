@@ -0,0 +1,497 @@
+#include "match.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "libchess/Position.h"
+
+#include "repetition.h"
+
+using namespace libchess;
+
+namespace match {
+
+EngineProcess::EngineProcess(const std::string& path) {
+    int to_child[2];
+    int from_child[2];
+    // Close-on-exec so engines started concurrently from other threads do not inherit these
+    // pipes and keep them open after this engine exits
+    if (pipe2(to_child, O_CLOEXEC) < 0) {
+        return;
+    }
+    if (pipe2(from_child, O_CLOEXEC) < 0) {
+        close(to_child[0]);
+        close(to_child[1]);
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(to_child[0], STDIN_FILENO);
+        dup2(from_child[1], STDOUT_FILENO);
+        close(to_child[0]);
+        close(to_child[1]);
+        close(from_child[0]);
+        close(from_child[1]);
+        // execvp so that a bare name such as "engine" is looked up on PATH
+        char* const argv[] = {const_cast<char*>(path.c_str()), nullptr};
+        execvp(path.c_str(), argv);
+        _exit(127);
+    }
+
+    close(to_child[0]);
+    close(from_child[1]);
+    if (pid < 0) {
+        close(to_child[1]);
+        close(from_child[0]);
+        return;
+    }
+    pid_ = pid;
+    to_engine_ = fdopen(to_child[1], "w");
+    from_engine_ = from_child[0];
+}
+
+EngineProcess::~EngineProcess() {
+    if (to_engine_) {
+        send("quit");
+        fclose(to_engine_);
+    }
+    if (from_engine_ >= 0) {
+        close(from_engine_);
+    }
+    if (pid_ > 0) {
+        // Give the engine a second to quit on its own; one that hangs is killed
+        int waited_ms = 0;
+        pid_t result;
+        while ((result = waitpid(pid_, nullptr, WNOHANG)) == 0 && waited_ms < 1000) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{10});
+            waited_ms += 10;
+        }
+        if (result == 0) {
+            kill(pid_, SIGKILL);
+            waitpid(pid_, nullptr, 0);
+        }
+    }
+}
+
+void EngineProcess::send(const std::string& line) {
+    if (!to_engine_) {
+        return;
+    }
+    std::fputs(line.c_str(), to_engine_);
+    std::fputc('\n', to_engine_);
+    std::fflush(to_engine_);
+}
+
+std::optional<std::string> EngineProcess::read_line(
+    std::optional<std::chrono::milliseconds> timeout) {
+    if (from_engine_ < 0) {
+        return std::nullopt;
+    }
+    auto deadline =
+        std::chrono::steady_clock::now() + timeout.value_or(std::chrono::milliseconds{0});
+    while (true) {
+        auto newline = read_buffer_.find('\n');
+        if (newline != std::string::npos) {
+            std::string line = read_buffer_.substr(0, newline);
+            read_buffer_.erase(0, newline + 1);
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            return line;
+        }
+
+        int wait_ms = -1;
+        if (timeout) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+            if (remaining.count() <= 0) {
+                return std::nullopt;
+            }
+            wait_ms = int(remaining.count());
+        }
+        pollfd poll_fd{from_engine_, POLLIN, 0};
+        int ready = poll(&poll_fd, 1, wait_ms);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        } else if (ready <= 0) {
+            return std::nullopt;
+        }
+
+        char chunk[4096];
+        ssize_t length = read(from_engine_, chunk, sizeof(chunk));
+        if (length < 0 && errno == EINTR) {
+            continue;
+        } else if (length <= 0) {
+            // The engine has exited; hand out a final unterminated line if there is one
+            if (read_buffer_.empty()) {
+                return std::nullopt;
+            }
+            std::string line;
+            line.swap(read_buffer_);
+            return line;
+        }
+        read_buffer_.append(chunk, std::size_t(length));
+    }
+}
+
+std::optional<std::string> EngineProcess::wait_for(
+    const std::string& prefix, std::optional<std::chrono::milliseconds> timeout) {
+    auto deadline =
+        std::chrono::steady_clock::now() + timeout.value_or(std::chrono::milliseconds{0});
+    auto remaining = [&]() -> std::optional<std::chrono::milliseconds> {
+        if (!timeout) {
+            return std::nullopt;
+        }
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+    };
+    while (auto line = read_line(remaining())) {
+        if (line->compare(0, prefix.size(), prefix) == 0) {
+            return line;
+        }
+    }
+    return std::nullopt;
+}
+
+std::string self_path(const std::string& fallback) {
+    char path[PATH_MAX];
+    ssize_t length = readlink("/proc/self/exe", path, sizeof(path));
+    if (length <= 0 || length == ssize_t(sizeof(path))) {
+        return fallback;
+    }
+    return std::string(path, std::size_t(length));
+}
+
+namespace {
+
+// ABORTED means an engine could not be started, which says nothing about its strength
+enum class GameResult { ENGINE0_WIN, DRAW, ENGINE1_WIN, ABORTED };
+
+const int MATE_SCORE = 30000;
+
+struct Stats {
+    int wins = 0;
+    int draws = 0;
+    int losses = 0;
+
+    [[nodiscard]] int games() const noexcept { return wins + draws + losses; }
+    [[nodiscard]] double score() const noexcept { return (wins + 0.5 * draws) / games(); }
+    [[nodiscard]] double variance() const noexcept {
+        double s = score();
+        return (wins * (1 - s) * (1 - s) + draws * (0.5 - s) * (0.5 - s) + losses * s * s) /
+               games();
+    }
+};
+
+double elo_to_score(double elo) { return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0)); }
+
+double score_to_elo(double score) {
+    score = std::min(std::max(score, 1e-6), 1.0 - 1e-6);
+    return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+// Log-likelihood ratio of elo1 against elo0 under the trinomial normal approximation
+double llr(const Stats& stats, double elo0, double elo1) {
+    if (stats.games() == 0) {
+        return 0.0;
+    }
+    double variance = stats.variance();
+    if (variance <= 0) {
+        return 0.0;
+    }
+    double s0 = elo_to_score(elo0);
+    double s1 = elo_to_score(elo1);
+    return stats.games() * (s1 - s0) * (2 * stats.score() - s0 - s1) / (2 * variance);
+}
+
+bool start_engine(EngineProcess& engine, const EngineConfig& config,
+                  std::chrono::milliseconds timeout) {
+    if (!engine.alive()) {
+        return false;
+    }
+    engine.send("uci");
+    if (!engine.wait_for("uciok", timeout)) {
+        return false;
+    }
+    for (auto& [name, value] : config.options) {
+        engine.send("setoption name " + name + " value " + value);
+    }
+    engine.send("ucinewgame");
+    engine.send("isready");
+    return bool(engine.wait_for("readyok", timeout));
+}
+
+// Readies a worker's engine for its next game, starting it on first use. A running engine is
+// told to stop, which drains the bestmove of a search left over from a game lost on time, and to
+// start a new game; one that has died or does not answer isready in time is restarted.
+bool prepare_engine(std::unique_ptr<EngineProcess>& engine, const EngineConfig& config,
+                    std::chrono::milliseconds timeout) {
+    if (engine) {
+        engine->send("stop");
+        engine->send("ucinewgame");
+        engine->send("isready");
+        if (engine->wait_for("readyok", timeout)) {
+            return true;
+        }
+        engine.reset();
+    }
+    engine = std::make_unique<EngineProcess>(config.path);
+    return start_engine(*engine, config, timeout);
+}
+
+// Score of the last info line, from the point of view of the engine that sent it
+std::optional<int> parse_score(const std::string& info_line) {
+    std::istringstream info_stream{info_line};
+    std::string token;
+    while (info_stream >> token) {
+        if (token != "score") {
+            continue;
+        }
+        std::string type;
+        int value;
+        if (!(info_stream >> type >> value)) {
+            return std::nullopt;
+        }
+        if (type == "cp") {
+            return value;
+        } else if (type == "mate") {
+            return value > 0 ? MATE_SCORE - value : -MATE_SCORE - value;
+        }
+    }
+    return std::nullopt;
+}
+
+// Plays one game between a worker's engines, which are kept running from game to game
+GameResult play_game(const MatchConfig& config, std::unique_ptr<EngineProcess> (&engines)[2],
+                     const std::string& opening_fen, int engine0_color) {
+    auto loss_for = [](int engine) {
+        return engine == 0 ? GameResult::ENGINE1_WIN : GameResult::ENGINE0_WIN;
+    };
+    for (int engine = 0; engine < 2; ++engine) {
+        if (!prepare_engine(engines[engine], config.engines[engine],
+                            std::chrono::milliseconds{config.startup_timeout_ms})) {
+            std::cout << "Unable to start " << config.engines[engine].path << "\n";
+            return GameResult::ABORTED;
+        }
+    }
+
+    Position pos = *Position::from_fen(opening_fen);
+    repetition::GameHistory history;
+    history.push(pos.hash());
+    std::string moves;
+    int clocks[2] = {config.base_time_ms, config.base_time_ms};
+    int resign_count[2] = {0, 0};
+    std::optional<int> last_score[2];
+    int draw_count = 0;
+
+    for (int ply = 0;; ++ply) {
+        if (pos.legal_move_list().empty()) {
+            int side_to_move = pos.side_to_move() == constants::WHITE ? 0 : 1;
+            int engine = side_to_move == engine0_color ? 0 : 1;
+            return pos.in_check() ? loss_for(engine) : GameResult::DRAW;
+        }
+        if (pos.halfmoves() >= 100 || history.is_threefold(pos.halfmoves()) ||
+            pos.occupancy_bb().popcount() == 2) {
+            return GameResult::DRAW;
+        }
+
+        int side_to_move = pos.side_to_move() == constants::WHITE ? 0 : 1;
+        int engine = side_to_move == engine0_color ? 0 : 1;
+        int white_engine = engine0_color == 0 ? 0 : 1;
+
+        engines[engine]->send("position fen " + opening_fen + (moves.empty() ? "" : " moves") +
+                              moves);
+        if (config.nodes) {
+            engines[engine]->send("go nodes " + std::to_string(*config.nodes));
+        } else {
+            std::string increment = std::to_string(config.increment_ms);
+            engines[engine]->send("go wtime " + std::to_string(clocks[white_engine]) + " btime " +
+                                  std::to_string(clocks[1 - white_engine]) + " winc " +
+                                  increment + " binc " + increment);
+        }
+
+        // An engine that stays silent past its clock plus the margin has lost on time, which also
+        // keeps a hung engine from stalling this worker
+        auto start_time = std::chrono::steady_clock::now();
+        auto deadline = start_time + std::chrono::milliseconds{
+                                         config.nodes ? config.move_timeout_ms
+                                                      : clocks[engine] + config.timeout_margin_ms};
+        auto remaining = [&deadline]() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+        };
+        std::optional<int> score;
+        std::optional<std::string> bestmove_line;
+        while (auto line = engines[engine]->read_line(remaining())) {
+            if (line->compare(0, 5, "info ") == 0) {
+                if (auto info_score = parse_score(*line)) {
+                    score = info_score;
+                }
+            } else if (line->compare(0, 9, "bestmove ") == 0) {
+                bestmove_line = line;
+                break;
+            }
+        }
+        if (!bestmove_line) {
+            return loss_for(engine);
+        }
+
+        if (!config.nodes) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start_time);
+            clocks[engine] -= int(elapsed.count());
+            if (clocks[engine] < 0) {
+                return loss_for(engine);
+            }
+            clocks[engine] += config.increment_ms;
+        }
+
+        std::istringstream bestmove_stream{*bestmove_line};
+        std::string token, move_str;
+        bestmove_stream >> token >> move_str;
+        std::optional<Move> played;
+        for (auto move : pos.legal_move_list()) {
+            if (move.to_str() == move_str) {
+                played = move;
+                break;
+            }
+        }
+        if (!played) {
+            return loss_for(engine);
+        }
+        pos.make_move(*played);
+        history.push(pos.hash());
+        moves += " " + move_str;
+
+        // Adjudication: resign once an engine has seen itself lost for a few moves and its
+        // opponent agrees, and call a draw once both have reported a near-zero score for a while
+        last_score[engine] = score;
+        if (score) {
+            resign_count[engine] = *score <= -config.resign_score ? resign_count[engine] + 1 : 0;
+            if (resign_count[engine] >= config.resign_moves && last_score[1 - engine] &&
+                *last_score[1 - engine] >= config.resign_score) {
+                return loss_for(engine);
+            }
+            draw_count = std::abs(*score) <= config.draw_score ? draw_count + 1 : 0;
+            if (ply / 2 + 1 >= config.draw_move_number && draw_count >= 2 * config.draw_moves) {
+                return GameResult::DRAW;
+            }
+        } else {
+            resign_count[engine] = 0;
+            draw_count = 0;
+        }
+    }
+}
+
+} // namespace
+
+int run(const MatchConfig& config) {
+    std::vector<std::string> openings;
+    std::ifstream openings_file{config.openings_path};
+    std::string line;
+    while (std::getline(openings_file, line)) {
+        std::istringstream line_stream{line};
+        std::string board, side, castling, enpassant;
+        if (line_stream >> board >> side >> castling >> enpassant &&
+            Position::from_fen(board + " " + side + " " + castling + " " + enpassant + " 0 1")) {
+            openings.push_back(board + " " + side + " " + castling + " " + enpassant + " 0 1");
+        }
+    }
+    if (openings.empty()) {
+        std::cout << "No openings found in " << config.openings_path << "\n";
+        return 2;
+    }
+
+    // A dead engine closes its pipe; report that as a lost game rather than dying of SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+
+    double lower_bound = std::log(config.beta / (1 - config.alpha));
+    double upper_bound = std::log((1 - config.beta) / config.alpha);
+
+    Stats stats;
+    std::mutex stats_mutex;
+    std::atomic<int> next_game{0};
+    std::atomic<bool> finished{false};
+    int result = 2;
+
+    auto worker = [&]() {
+        std::unique_ptr<EngineProcess> engines[2];
+        while (!finished) {
+            int game = next_game++;
+            if (game >= config.max_games) {
+                break;
+            }
+            // Each opening is played twice so both engines get both colors
+            const std::string& opening = openings[(game / 2) % openings.size()];
+            GameResult game_result = play_game(config, engines, opening, game % 2);
+
+            std::lock_guard<std::mutex> lock{stats_mutex};
+            if (finished) {
+                break;
+            }
+            if (game_result == GameResult::ABORTED) {
+                std::cout << "Match aborted\n";
+                result = 2;
+                finished = true;
+                break;
+            }
+            if (game_result == GameResult::ENGINE0_WIN) {
+                ++stats.wins;
+            } else if (game_result == GameResult::DRAW) {
+                ++stats.draws;
+            } else {
+                ++stats.losses;
+            }
+
+            double elo = score_to_elo(stats.score());
+            double margin = 1.96 * std::sqrt(stats.variance() / stats.games());
+            double elo_error = (score_to_elo(stats.score() + margin) -
+                                score_to_elo(stats.score() - margin)) /
+                               2;
+            double current_llr = llr(stats, config.elo0, config.elo1);
+            std::cout << "Games " << stats.games() << ": +" << stats.wins << " =" << stats.draws
+                      << " -" << stats.losses << std::fixed << std::setprecision(2) << ", Elo "
+                      << elo << " +/- " << elo_error << ", LLR " << current_llr << " ("
+                      << lower_bound << ", " << upper_bound << ")\n";
+
+            if (current_llr >= upper_bound) {
+                std::cout << "SPRT: H1 accepted\n";
+                result = 0;
+                finished = true;
+            } else if (current_llr <= lower_bound) {
+                std::cout << "SPRT: H0 accepted\n";
+                result = 1;
+                finished = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < std::max(config.concurrency, 1); ++i) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    return result;
+}
+
+} // namespace match
@@ -0,0 +1,81 @@
+#ifndef MATCH_H
+#define MATCH_H
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace match {
+
+struct EngineConfig {
+    std::string path;
+    std::vector<std::pair<std::string, std::string>> options;
+};
+
+struct MatchConfig {
+    EngineConfig engines[2];
+    std::string openings_path;
+    int concurrency = 1;
+    int max_games = 1000;
+    std::optional<std::uint64_t> nodes;
+    int base_time_ms = 10000;
+    int increment_ms = 100;
+    double elo0 = 0.0;
+    double elo1 = 5.0;
+    double alpha = 0.05;
+    double beta = 0.05;
+    int resign_score = 1000;
+    int resign_moves = 4;
+    int draw_score = 10;
+    int draw_moves = 8;
+    int draw_move_number = 40;
+    // A silent engine loses on time once its clock plus this margin has run out; in fixed-node
+    // games it gets move_timeout_ms per move instead
+    int timeout_margin_ms = 1000;
+    int move_timeout_ms = 60000;
+    int startup_timeout_ms = 10000;
+};
+
+// A UCI engine running as a child process, spoken to over a pair of pipes.
+class EngineProcess {
+  public:
+    explicit EngineProcess(const std::string& path);
+    ~EngineProcess();
+    EngineProcess(const EngineProcess&) = delete;
+    EngineProcess& operator=(const EngineProcess&) = delete;
+
+    [[nodiscard]] bool alive() const noexcept { return pid_ > 0; }
+    void send(const std::string& line);
+    // Returns the next line, or nothing if the engine exits or the timeout passes first
+    std::optional<std::string> read_line(std::optional<std::chrono::milliseconds> timeout = {});
+    // Reads lines until one starts with prefix, returning it, or nothing if the engine exits or
+    // the timeout passes first
+    std::optional<std::string> wait_for(const std::string& prefix,
+                                        std::optional<std::chrono::milliseconds> timeout = {});
+
+  private:
+    pid_t pid_ = -1;
+    FILE* to_engine_ = nullptr;
+    int from_engine_ = -1;
+    std::string read_buffer_;
+};
+
+// Path of the running executable, so an installed engine can play itself by default. Falls back
+// to the given path where /proc/self/exe is not available.
+std::string self_path(const std::string& fallback);
+
+// Plays engine 0 against engine 1 from every opening with both colors on a pool of threads
+// until max_games are played or the SPRT reaches a decision. Returns 0 if engine 0 passed the
+// SPRT, 1 if it failed and 2 if the match ended without a result, including when an engine
+// cannot be started.
+int run(const MatchConfig& config);
+
+} // namespace match
+
+#endif // MATCH_H
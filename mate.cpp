@@ -0,0 +1,291 @@
+#include "mate.h"
+
+#include <algorithm>
+#include <utility>
+
+using namespace libchess;
+
+namespace mate {
+
+MateTable::MateTable(int MB) {
+    std::uint64_t num_entries = 1;
+    while (num_entries * 2 * sizeof(MateEntry) <= std::uint64_t(MB) * 1024 * 1024) {
+        num_entries *= 2;
+    }
+    table_.resize(num_entries);
+    mask_ = num_entries - 1;
+}
+
+void MateTable::clear() { std::fill(table_.begin(), table_.end(), MateEntry{}); }
+
+std::optional<MateEntry> MateTable::probe(std::uint64_t key) const noexcept {
+    const MateEntry& entry = table_[key & mask_];
+    if (entry.key != key) {
+        return std::nullopt;
+    }
+    return entry;
+}
+
+void MateTable::write(std::uint64_t key, std::uint32_t phi, std::uint32_t delta) noexcept {
+    table_[key & mask_] = MateEntry{key, phi, delta};
+}
+
+namespace {
+
+const std::uint32_t INF = 1U << 30U;
+
+// Created on the first mate search, so engines that never run one do not pay for it
+MateTable& mate_table() {
+    static MateTable table(16);
+    return table;
+}
+
+using ProofNumbers = std::pair<std::uint32_t, std::uint32_t>;
+
+std::uint64_t node_key(std::uint64_t hash, int moves_left) {
+    return hash ^ (std::uint64_t(moves_left + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+struct Child {
+    Move move;
+    std::uint64_t key;
+    // Repetitions and fifty-move draws depend on the path, so they are never stored
+    bool draw;
+    // The child's numbers as last seen by its parent, which keeps them while it iterates rather
+    // than probing the always-replace table for them again
+    ProofNumbers numbers;
+};
+
+class Solver {
+  public:
+    Solver(Position& pos, search::SearchGlobals& sg)
+        : pos_(pos), sg_(sg), table_(mate_table()) {}
+
+    // Every check while the attacker has moves left, every legal evasion for the defender
+    MoveList node_moves(bool attacker, int moves_left) {
+        MoveList moves;
+        if (attacker) {
+            if (moves_left == 0) {
+                return moves;
+            }
+            for (auto move : pos_.legal_move_list()) {
+                pos_.make_move(move);
+                bool check = pos_.in_check();
+                pos_.unmake_move();
+                if (check) {
+                    moves.add(move);
+                }
+            }
+        } else {
+            for (auto move : pos_.check_evasion_move_list()) {
+                if (pos_.is_legal_generated_move(move)) {
+                    moves.add(move);
+                }
+            }
+        }
+        return moves;
+    }
+
+    std::vector<Child> children(const MoveList& moves, bool child_attacker,
+                                int child_moves_left) {
+        std::vector<Child> result;
+        result.reserve(moves.size());
+        for (auto move : moves) {
+            pos_.make_move(move);
+            Child child{move, node_key(pos_.hash(), child_moves_left),
+                        pos_.halfmoves() >= 100 || pos_.is_repeat(), {}};
+            pos_.unmake_move();
+            child.numbers = child_numbers(child, child_attacker, child_moves_left);
+            result.push_back(child);
+        }
+        return result;
+    }
+
+    // Proof numbers of a child from its own side to move's point of view. A draw is a win for
+    // the defender, and an attacker with no moves left has lost.
+    ProofNumbers child_numbers(const Child& child, bool child_attacker, int child_moves_left) {
+        if (child.draw || (child_attacker && child_moves_left == 0)) {
+            return child_attacker ? ProofNumbers{INF, 0} : ProofNumbers{0, INF};
+        }
+        if (auto entry = table_.probe(child.key)) {
+            return {entry->phi, entry->delta};
+        }
+        return {1, 1};
+    }
+
+    // Whether a child is a proven loss for its side to move, proving it again if the table no
+    // longer holds its result
+    bool is_lost(const Child& child, bool child_attacker, int child_moves_left) {
+        auto numbers = child_numbers(child, child_attacker, child_moves_left);
+        if (numbers.first != 0 && numbers.second != 0) {
+            pos_.make_move(child.move);
+            numbers = mid(child_attacker, child_moves_left, INF, INF);
+            pos_.unmake_move();
+        }
+        return numbers.second == 0;
+    }
+
+    // Expands the current node until its phi or delta reaches the given threshold
+    ProofNumbers mid(bool attacker, int moves_left, std::uint32_t th_phi,
+                     std::uint32_t th_delta) {
+        sg_.increment_nodes();
+        auto key = node_key(pos_.hash(), moves_left);
+        auto moves = node_moves(attacker, moves_left);
+        if (moves.empty()) {
+            // The attacker is out of checks, or the defender, always in check here, is mated
+            table_.write(key, INF, 0);
+            return {INF, 0};
+        }
+
+        int child_moves_left = attacker ? moves_left - 1 : moves_left;
+        auto nodes = children(moves, !attacker, child_moves_left);
+        while (true) {
+            std::uint32_t phi = INF;
+            std::uint64_t delta = 0;
+            std::size_t best = 0;
+            std::uint32_t best_phi = 0;
+            std::uint32_t second_delta = INF;
+            for (std::size_t i = 0; i < nodes.size(); ++i) {
+                auto [child_phi, child_delta] = nodes[i].numbers;
+                delta += child_phi;
+                if (child_delta < phi) {
+                    second_delta = phi;
+                    phi = child_delta;
+                    best = i;
+                    best_phi = child_phi;
+                } else if (child_delta < second_delta) {
+                    second_delta = child_delta;
+                }
+            }
+            delta = std::min<std::uint64_t>(delta, INF);
+
+            if (phi >= th_phi || delta >= th_delta || sg_.stop()) {
+                table_.write(key, phi, std::uint32_t(delta));
+                return {phi, std::uint32_t(delta)};
+            }
+
+            auto child_th_phi =
+                std::uint32_t(std::min<std::uint64_t>(th_delta + best_phi - delta, INF));
+            auto child_th_delta = std::min(th_phi, second_delta + 1);
+            pos_.make_move(nodes[best].move);
+            nodes[best].numbers = mid(!attacker, child_moves_left, child_th_phi, child_th_delta);
+            pos_.unmake_move();
+        }
+    }
+
+    // Follows the quickest mating move at attacker nodes and the longest resisting evasion at
+    // defender nodes, so the line is as long as the mate the defender cannot avoid. Each node is
+    // proven once per candidate length, and its children are read back from the table.
+    MoveList principal_variation(int moves_left) {
+        MoveList pv;
+        bool attacker = true;
+        while (true) {
+            std::optional<Move> next;
+            if (attacker) {
+                // The first length that proves the node is its quickest mate
+                int length = 1;
+                while (length <= moves_left && mid(true, length, INF, INF).first != 0) {
+                    ++length;
+                }
+                if (length > moves_left) {
+                    break;
+                }
+                for (auto& child : children(node_moves(true, length), false, length - 1)) {
+                    if (is_lost(child, false, length - 1)) {
+                        next = child.move;
+                        break;
+                    }
+                }
+                moves_left = length - 1;
+            } else {
+                auto moves = node_moves(false, moves_left);
+                if (moves.empty()) {
+                    break;
+                }
+                // Shorten the mate while the node stays lost, then take an evasion that the
+                // shorter mate does not cover
+                while (moves_left > 1 && mid(false, moves_left - 1, INF, INF).second == 0) {
+                    --moves_left;
+                }
+                for (auto& child : children(moves, true, moves_left - 1)) {
+                    if (!child.draw && is_lost(child, true, moves_left - 1)) {
+                        next = child.move;
+                        break;
+                    }
+                }
+            }
+            if (!next) {
+                break;
+            }
+            pv.add(*next);
+            pos_.make_move(*next);
+            attacker = !attacker;
+        }
+        for (unsigned i = 0; i < pv.size(); ++i) {
+            pos_.unmake_move();
+        }
+        return pv;
+    }
+
+    // The check whose defending side has the smallest disproof number left
+    std::optional<Move> most_promising(int moves_left) {
+        auto nodes = children(node_moves(true, moves_left), false, moves_left - 1);
+        std::optional<Move> best;
+        std::uint32_t best_delta = INF + 1;
+        for (auto& child : nodes) {
+            if (child.numbers.second < best_delta) {
+                best_delta = child.numbers.second;
+                best = child.move;
+            }
+        }
+        return best;
+    }
+
+  private:
+    Position& pos_;
+    search::SearchGlobals& sg_;
+    MateTable& table_;
+};
+
+} // namespace
+
+std::optional<Move> mate_search(Position& pos, int max_moves,
+                                search::SearchGlobals& search_globals) {
+    auto start_time = search::curr_time();
+    search_globals.set_stop_flag(false);
+    search_globals.set_side_to_move(pos.side_to_move());
+    search_globals.reset_nodes();
+    search_globals.set_start_time(start_time);
+    mate_table().clear();
+
+    Solver solver{pos, search_globals};
+    std::optional<Move> best_move;
+    for (int moves = 1; moves <= max_moves && !search_globals.stop(); ++moves) {
+        if (solver.mid(true, moves, INF, INF).first != 0) {
+            if (auto move = solver.most_promising(moves)) {
+                best_move = move;
+            }
+            continue;
+        }
+
+        auto pv = solver.principal_variation(moves);
+        if (pv.empty()) {
+            break;
+        }
+        // Mate in n is 2n - 1 plies away whatever line the defender chooses
+        auto time_diff = search::curr_time() - start_time;
+        search::print_info(2 * moves - 1, search::MATE_SCORE - (2 * moves - 1),
+                           time_diff.count(), search_globals.nodes(), pv);
+        return *pv.begin();
+    }
+
+    if (!best_move) {
+        auto move_list = pos.legal_move_list();
+        if (!move_list.empty()) {
+            best_move = *move_list.begin();
+        }
+    }
+    return best_move;
+}
+
+} // namespace mate
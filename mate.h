@@ -0,0 +1,49 @@
+#ifndef MATE_H
+#define MATE_H
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "libchess/Position.h"
+
+#include "search.h"
+
+namespace mate {
+
+// Proof and disproof numbers of a position from the point of view of its side to move: phi is
+// the proof number of a win for it and delta that of a loss. A node is won when phi is 0 and
+// lost when delta is 0.
+struct MateEntry {
+    std::uint64_t key;
+    std::uint32_t phi;
+    std::uint32_t delta;
+};
+static_assert(sizeof(MateEntry) == 16, "MateEntry must stay 16 bytes");
+
+// Always-replace table for the mate solver, kept apart from the main TT so that proof numbers
+// never evict search results. Keys combine the position hash with the number of attacking moves
+// left, as the same position can be won with three moves to spare and lost with one.
+class MateTable {
+  public:
+    explicit MateTable(int MB);
+
+    void clear();
+    [[nodiscard]] std::optional<MateEntry> probe(std::uint64_t key) const noexcept;
+    void write(std::uint64_t key, std::uint32_t phi, std::uint32_t delta) noexcept;
+
+  private:
+    std::vector<MateEntry> table_;
+    std::uint64_t mask_;
+};
+
+// Looks for a forced mate in at most max_moves moves of the side to move with depth-first proof
+// number search over checks and evasions, trying one more attacking move each iteration so the
+// first mate found is the shortest. Prints an info line with a mate score when it succeeds and
+// returns the first move of the mate, or the most promising check if no mate was proven.
+std::optional<libchess::Move> mate_search(libchess::Position& pos, int max_moves,
+                                          search::SearchGlobals& search_globals);
+
+} // namespace mate
+
+#endif // MATE_H
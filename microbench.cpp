@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "libchess/Position.h"
+
+#include "cpu.h"
+#include "evaluation.h"
+#include "search.h"
+#include "tt.h"
+
+using namespace libchess;
+
+namespace {
+
+const std::vector<std::string> CORPUS{{
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+}};
+
+const int WARMUP_ROUNDS = 100;
+const int TRIALS = 7;
+const int ROUNDS_PER_TRIAL = 2000;
+
+// Results are folded in here so the compiler cannot discard the work being timed
+volatile std::uint64_t sink;
+
+// Runs `round` (which performs `ops_per_round` operations) for a warm-up period and then for
+// several timed trials, reporting the best and median cost per operation.
+void bench(const std::string& name, std::uint64_t ops_per_round,
+           const std::function<std::uint64_t()>& round) {
+    std::uint64_t result = 0;
+    for (int i = 0; i < WARMUP_ROUNDS; ++i) {
+        result += round();
+    }
+
+    std::vector<double> ns_per_op;
+    for (int trial = 0; trial < TRIALS; ++trial) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ROUNDS_PER_TRIAL; ++i) {
+            result += round();
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+        ns_per_op.push_back(double(elapsed.count()) / double(ops_per_round * ROUNDS_PER_TRIAL));
+    }
+    sink = sink + result;
+
+    std::sort(ns_per_op.begin(), ns_per_op.end());
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed
+              << std::setprecision(2) << std::setw(10) << ns_per_op.front() << " ns/op (best)"
+              << std::setw(10) << ns_per_op[ns_per_op.size() / 2] << " ns/op (median)\n";
+}
+
+} // namespace
+
+int main() {
+    std::vector<Position> positions;
+    for (auto& fen : CORPUS) {
+        positions.push_back(*Position::from_fen(fen));
+    }
+
+    std::uint64_t num_moves = 0;
+    for (auto& pos : positions) {
+        num_moves += pos.legal_move_list().size();
+    }
+
+    // Every kernel variant this machine can run, ending with the one the engine selects
+    std::vector<cpu::Variant> variants;
+    for (auto variant : {cpu::Variant::GENERIC, cpu::Variant::POPCNT, cpu::Variant::BMI2}) {
+        if (cpu::supports(variant) && variant != cpu::best_variant()) {
+            variants.push_back(variant);
+        }
+    }
+    variants.push_back(cpu::best_variant());
+
+    for (auto variant : variants) {
+        eval::set_cpu_variant(variant);
+        bench(std::string{"eval::evaluate ("} + cpu::variant_name(variant) + ")", positions.size(),
+              [&]() {
+                  std::uint64_t total = 0;
+                  for (auto& pos : positions) {
+                      total += eval::evaluate(pos);
+                  }
+                  return total;
+              });
+    }
+
+    bench("legal_move_list", positions.size(), [&]() {
+        std::uint64_t total = 0;
+        for (auto& pos : positions) {
+            total += pos.legal_move_list().size();
+        }
+        return total;
+    });
+
+    bench("generate_capture_moves", positions.size(), [&]() {
+        std::uint64_t total = 0;
+        for (auto& pos : positions) {
+            MoveList move_list;
+            pos.generate_capture_moves(move_list, pos.side_to_move());
+            total += move_list.size();
+        }
+        return total;
+    });
+
+    std::vector<MoveList> move_lists;
+    for (auto& pos : positions) {
+        move_lists.push_back(pos.legal_move_list());
+    }
+
+    bench("make_move/unmake_move", num_moves, [&]() {
+        std::uint64_t total = 0;
+        for (std::size_t i = 0; i < positions.size(); ++i) {
+            for (auto move : move_lists[i]) {
+                positions[i].make_move(move);
+                total += positions[i].hash();
+                positions[i].unmake_move();
+            }
+        }
+        return total;
+    });
+
+    auto search_stack = search::SearchStack::new_search_stack();
+    bench("sort_moves", positions.size(), [&]() {
+        std::uint64_t total = 0;
+        for (std::size_t i = 0; i < positions.size(); ++i) {
+            MoveList move_list = move_lists[i];
+            search::sort_moves(positions[i], move_list, search_stack.begin());
+            total += move_list.begin()->value();
+        }
+        return total;
+    });
+
+    // Pseudo-random keys so the accesses land in clusters spread over the whole table
+    const int NUM_KEYS = 4096;
+    std::vector<std::uint64_t> keys(NUM_KEYS);
+    std::uint64_t seed = 0x9E3779B97F4A7C15;
+    for (auto& key : keys) {
+        seed ^= seed << 13U;
+        seed ^= seed >> 7U;
+        seed ^= seed << 17U;
+        key = seed;
+    }
+
+    bench("TranspositionTable::write", NUM_KEYS, [&]() {
+        for (int i = 0; i < NUM_KEYS; ++i) {
+            tt.write(0, FLAG_EXACT, i & 63, i, keys[i]);
+        }
+        return std::uint64_t(0);
+    });
+
+    bench("TranspositionTable::probe", NUM_KEYS, [&]() {
+        std::uint64_t total = 0;
+        for (int i = 0; i < NUM_KEYS; ++i) {
+            total += tt.probe(keys[i]).get_depth();
+        }
+        return total;
+    });
+
+    // Whole-search throughput for each kernel variant: a fixed-depth search of every corpus
+    // position from an empty table
+    const int SEARCH_DEPTH = 7;
+    for (auto variant : variants) {
+        eval::set_cpu_variant(variant);
+        std::uint64_t search_nodes = 0;
+        std::uint64_t search_qnodes = 0;
+        auto search_start = std::chrono::steady_clock::now();
+        for (auto& pos : positions) {
+            tt.clear();
+            auto search_globals = search::SearchGlobals::new_search_globals();
+            search_globals.set_depth_limit(SEARCH_DEPTH);
+            search_globals.set_iteration_handler(
+                [](int, int, std::uint64_t, std::chrono::milliseconds, const MoveList&) {});
+            sink = sink + search::best_move_search(pos, search_globals)->value();
+            search_nodes += search_globals.nodes();
+            search_qnodes += search_globals.qnodes();
+        }
+        auto search_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - search_start);
+        std::cout << "search depth " << SEARCH_DEPTH << " (" << cpu::variant_name(variant)
+                  << "): " << search_nodes << " nodes (" << search_qnodes << " qnodes), "
+                  << search_time.count() << " ms, "
+                  << search_nodes * 1000 / std::max<std::uint64_t>(search_time.count(), 1)
+                  << " nps\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef REPETITION_H
+#define REPETITION_H
+
+#include <cstdint>
+#include <vector>
+
+namespace repetition {
+
+// Hashes of the positions of one game, for the threefold repetition rule. A search can treat a
+// single repeat as a draw, but a game is only drawn once the same position has occurred three
+// times.
+class GameHistory {
+  public:
+    void clear() noexcept { hashes_.clear(); }
+    void push(std::uint64_t hash) { hashes_.push_back(hash); }
+
+    // Whether the last position pushed has occurred twice before. Only the last halfmoves
+    // positions can repeat it, since a capture or pawn move in between cannot be undone.
+    [[nodiscard]] bool is_threefold(int halfmoves) const noexcept {
+        if (hashes_.empty()) {
+            return false;
+        }
+        std::uint64_t current = hashes_.back();
+        int earlier = 0;
+        // The same position recurs with the same side to move, so only every other ply matters
+        for (int back = 4; back <= halfmoves && back < int(hashes_.size()); back += 2) {
+            if (hashes_[hashes_.size() - 1 - std::size_t(back)] == current && ++earlier == 2) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+  private:
+    std::vector<std::uint64_t> hashes_;
+};
+
+} // namespace repetition
+
+#endif // REPETITION_H
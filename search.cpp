@@ -1,8 +1,11 @@
+#include <algorithm>
 #include <chrono>
+#include <iostream>
 
 #include "evaluation.h"
 #include "search.h"
 
+#include "trace.h"
 #include "tt.h"
 
 using namespace libchess;
@@ -10,24 +13,13 @@ using namespace eval;
 
 namespace search {
 
-struct SearchStack {
-    static std::array<SearchStack, MAX_PLY> new_search_stack() noexcept {
-        std::array<SearchStack, MAX_PLY> search_stack{};
-        for (unsigned i = 0; i < search_stack.size(); ++i) {
-            auto& ss = search_stack[i];
-            ss.ply = int(i);
-            ss.killer_moves = {{std::nullopt, std::nullopt}};
-        }
-        return search_stack;
-    }
-
-    std::array<std::optional<Move>, 2> killer_moves;
-    int ply;
-};
+TranspositionTable& SearchGlobals::transposition_table() const noexcept {
+    return transposition_table_ ? *transposition_table_ : tt;
+}
 
 void sort_moves(const Position& pos, MoveList& move_list, SearchStack* ss,
-                std::optional<Move> tt_move = {}) {
-    move_list.sort([&](Move move) {
+                std::optional<Move> tt_move) {
+    auto scorer = [&pos, ss, tt_move](Move move) {
         auto from_pt = *pos.piece_type_on(move.from_square());
         auto to_pt = pos.piece_type_on(move.to_square());
 
@@ -51,53 +43,139 @@ void sort_moves(const Position& pos, MoveList& move_list, SearchStack* ss,
         } else {
             return 0;
         }
-    });
+    };
+    // The standard forbids std::function from throwing, and so from allocating, when it wraps a
+    // reference_wrapper
+    move_list.sort(std::ref(scorer));
+}
+
+// Generates pseudo-legal moves into a ply's own list: captures and promotions, plus quiet moves
+// if asked for. libchess hands out check evasions only as a new list, so in check every move is
+// generated this way and those that do not answer the check fail leaves_king_attacked().
+void generate_moves(const Position& pos, MoveList& move_list, bool quiets) {
+    move_list.clear();
+    pos.generate_capture_moves(move_list, pos.side_to_move());
+    if (quiets) {
+        pos.generate_quiet_moves(move_list, pos.side_to_move());
+    } else {
+        pos.generate_promotions(move_list, pos.side_to_move());
+    }
 }
 
-int qsearch_impl(Position& pos, int alpha, int beta, SearchStack* ss, SearchGlobals& sg) {
+// Mate scores count plies from the root, but an entry can be read back at another ply. They are
+// stored as plies from the node and converted back on probe.
+int score_to_tt(int score, int ply) {
+    if (score >= MAX_MATE_SCORE) {
+        return score + ply;
+    } else if (score <= -MAX_MATE_SCORE) {
+        return score - ply;
+    }
+    return score;
+}
+
+int score_from_tt(int score, int ply) {
+    if (score >= MAX_MATE_SCORE) {
+        return score - ply;
+    } else if (score <= -MAX_MATE_SCORE) {
+        return score + ply;
+    }
+    return score;
+}
+
+// Whether the move just made by mover left its king capturable. The captures of the side to move
+// go into the child frame's list, which the child clears before generating its own moves.
+bool leaves_king_attacked(const Position& pos, Color mover, MoveList& scratch) {
+    Square king_square = pos.piece_type_bb(constants::KING, mover).forward_bitscan();
+    scratch.clear();
+    pos.generate_capture_moves(scratch, pos.side_to_move());
+    return std::any_of(scratch.begin(), scratch.end(),
+                       [king_square](Move move) { return move.to_square() == king_square; });
+}
+
+// horizon is set on the first quiescence ply, entered from search_impl or qsearch()
+int qsearch_impl(Position& pos, int alpha, int beta, SearchStack* ss, SearchGlobals& sg,
+                 bool horizon) {
+    ss->pv.clear();
+
     if (sg.stop()) {
         return 0;
     }
 
     sg.increment_nodes();
+    sg.increment_qnodes();
 
     if (ss->ply >= MAX_PLY) {
         return evaluate(pos);
     }
 
-    int eval = evaluate(pos);
-    if (eval > alpha) {
-        alpha = eval;
-    }
-    if (eval >= beta) {
-        return beta;
-    }
-
-    MoveList move_list;
-    if (pos.in_check()) {
-        move_list = pos.check_evasion_move_list();
+    bool pv_node = alpha != beta - 1;
+    int original_alpha = alpha;
 
-        if (move_list.empty()) {
-            return pos.in_check() ? -MATE_SCORE + ss->ply : 0;
+    // Quiescence results are stored at depth 0, so every entry is deep enough to cut on and
+    // search_impl entries for the same position are never replaced by shallower ones from here
+    auto hash = pos.hash();
+    TranspositionTable& table = sg.transposition_table();
+    TTEntry tt_entry = table.probe(hash);
+    Move tt_move{0};
+    bool tt_hit = tt_entry.get_key() == hash;
+    trace::record(trace::QNODE_ENTER, ss->ply, 0, alpha, beta, 0, pos.previous_move(), tt_hit);
+    if (tt_hit) {
+        tt_move = Move{tt_entry.get_move()};
+        int tt_score = score_from_tt(tt_entry.get_score(), ss->ply);
+        int tt_flag = tt_entry.get_flag();
+        if (!pv_node && (tt_flag == TTConstants::FLAG_EXACT ||
+                         (tt_flag == TTConstants::FLAG_LOWER && tt_score >= beta) ||
+                         (tt_flag == TTConstants::FLAG_UPPER && tt_score <= alpha))) {
+            trace::record(trace::QNODE_EXIT, ss->ply, 0, alpha, beta, tt_score, tt_move, true,
+                          trace::EXIT_TT_CUTOFF);
+            return tt_score;
+        }
+    }
+    bool tt_writable = !tt_hit || tt_entry.get_depth() == 0;
+
+    // Every evasion is searched when in check. A check given by the last move of the main search
+    // gets no stand-pat, as the side to move may be mated; one given by a quiescence capture
+    // keeps it, which is cheaper and loses little as those lines are mostly exchanges.
+    bool in_check = pos.in_check();
+    if (!in_check || !horizon) {
+        int eval = evaluate(pos);
+        if (eval > alpha) {
+            alpha = eval;
+        }
+        if (eval >= beta) {
+            if (tt_writable) {
+                table.write(0, FLAG_LOWER, 0, eval, hash);
+            }
+            trace::record(trace::QNODE_EXIT, ss->ply, 0, alpha, beta, beta, {}, tt_hit,
+                          trace::EXIT_STAND_PAT);
+            return beta;
         }
-    } else {
-        pos.generate_capture_moves(move_list, pos.side_to_move());
-        pos.generate_promotions(move_list, pos.side_to_move());
     }
 
-    sort_moves(pos, move_list, ss);
+    MoveList& move_list = ss->moves;
+    generate_moves(pos, move_list, in_check);
+    sort_moves(pos, move_list, ss, tt_move);
 
+    Color us = pos.side_to_move();
     int move_num = 0;
     int best_score = -INFINITE;
+    Move best_move{0};
     for (auto move : move_list) {
-        if (!pos.is_legal_generated_move(move)) {
+        if (!pos.is_legal_generated_move(move) ||
+            (in_check && move.type() == Move::Type::CASTLING)) {
             continue;
         }
         pos.make_move(move);
-        int score = -qsearch_impl(pos, -beta, -alpha, ss + 1, sg);
+        if (in_check && leaves_king_attacked(pos, us, (ss + 1)->moves)) {
+            pos.unmake_move();
+            continue;
+        }
+        table.prefetch(pos.hash());
+        int score = -qsearch_impl(pos, -beta, -alpha, ss + 1, sg, false);
         pos.unmake_move();
 
         if (sg.stop()) {
+            trace::record(trace::QNODE_EXIT, ss->ply, 0, alpha, beta, 0, {}, tt_hit);
             return 0;
         }
 
@@ -107,6 +185,7 @@ int qsearch_impl(Position& pos, int alpha, int beta, SearchStack* ss, SearchGlob
             best_score = score;
             if (best_score > alpha) {
                 alpha = best_score;
+                best_move = move;
                 if (alpha >= beta) {
                     break;
                 }
@@ -114,49 +193,68 @@ int qsearch_impl(Position& pos, int alpha, int beta, SearchStack* ss, SearchGlob
         }
     }
 
+    if (in_check && !move_num) {
+        alpha = -MATE_SCORE + ss->ply;
+    }
+
+    if (tt_writable) {
+        int tt_flag = alpha >= beta              ? TTConstants::FLAG_LOWER
+                      : alpha <= original_alpha ? TTConstants::FLAG_UPPER
+                                                : TTConstants::FLAG_EXACT;
+        table.write(best_move.value(), tt_flag, 0, score_to_tt(alpha, ss->ply), hash);
+    }
+    trace::record(trace::QNODE_EXIT, ss->ply, 0, alpha, beta, alpha, best_move, tt_hit,
+                  trace::EXIT_SEARCHED, move_num);
     return alpha;
 }
 
-SearchResult search_impl(Position& pos, int alpha, int beta, int depth, SearchStack* ss,
-                         SearchGlobals& sg) {
+int search_impl(Position& pos, int alpha, int beta, int depth, SearchStack* ss,
+                SearchGlobals& sg) {
     if (depth <= 0) {
-        return {qsearch_impl(pos, alpha, beta, ss, sg), {}};
+        return qsearch_impl(pos, alpha, beta, ss, sg, true);
     }
 
+    ss->pv.clear();
+
     if (ss->ply) {
         if (sg.stop()) {
-            return {0, {}};
+            return 0;
         }
 
         if (pos.halfmoves() >= 100 || pos.is_repeat()) {
-            return {0, {}};
+            return 0;
         }
 
         if (ss->ply >= MAX_PLY) {
-            return {evaluate(pos), {}};
+            return evaluate(pos);
         }
 
         alpha = std::max((-MATE_SCORE + ss->ply), alpha);
         beta = std::min((MATE_SCORE - ss->ply), beta);
         if (alpha >= beta) {
-            return {alpha, {}};
+            return alpha;
         }
     }
 
     bool pv_node = alpha != beta - 1;
 
     auto hash = pos.hash();
-    TTEntry tt_entry = tt.probe(hash);
+    TranspositionTable& table = sg.transposition_table();
+    TTEntry tt_entry = table.probe(hash);
     Move tt_move{0};
-    if (tt_entry.get_key() == hash) {
+    bool tt_hit = tt_entry.get_key() == hash;
+    trace::record(trace::NODE_ENTER, ss->ply, depth, alpha, beta, 0, pos.previous_move(), tt_hit);
+    if (tt_hit) {
         tt_move = Move{tt_entry.get_move()};
-        int tt_score = tt_entry.get_score();
+        int tt_score = score_from_tt(tt_entry.get_score(), ss->ply);
         int tt_flag = tt_entry.get_flag();
         if (!pv_node && tt_entry.get_depth() >= depth) {
             if (tt_flag == TTConstants::FLAG_EXACT ||
                 (tt_flag == TTConstants::FLAG_LOWER && tt_score >= beta) ||
                 (tt_flag == TTConstants::FLAG_UPPER && tt_score <= alpha)) {
-                return {tt_score, {}};
+                trace::record(trace::NODE_EXIT, ss->ply, depth, alpha, beta, tt_score, tt_move,
+                              true, trace::EXIT_TT_CUTOFF);
+                return tt_score;
             }
         }
     }
@@ -167,50 +265,58 @@ SearchResult search_impl(Position& pos, int alpha, int beta, int depth, SearchSt
         !pos.in_check() && pos.previous_move() && beta > -MAX_MATE_SCORE) {
         int static_eval = evaluate(pos);
         if (depth < 3 && static_eval - 150 * depth >= beta) {
-            return {static_eval, {}};
+            trace::record(trace::NODE_EXIT, ss->ply, depth, alpha, beta, static_eval, {}, tt_hit,
+                          trace::EXIT_PRUNED);
+            return static_eval;
         }
     }
 
     sg.increment_nodes();
 
-    MoveList pv;
+    Move best_move{0};
     int best_score = -INFINITE;
-    auto move_list = pos.legal_move_list();
-
-    if (move_list.empty()) {
-        return {pos.in_check() ? -MATE_SCORE + ss->ply : 0, {}};
-    }
-
+    bool in_check = pos.in_check();
+    MoveList& move_list = ss->moves;
+    generate_moves(pos, move_list, true);
     sort_moves(pos, move_list, ss, tt_move);
 
+    Color us = pos.side_to_move();
     int move_num = 0;
     for (auto move : move_list) {
+        if (!pos.is_legal_generated_move(move) ||
+            (in_check && move.type() == Move::Type::CASTLING)) {
+            continue;
+        }
+        pos.make_move(move);
+        if (in_check && leaves_king_attacked(pos, us, (ss + 1)->moves)) {
+            pos.unmake_move();
+            continue;
+        }
         ++move_num;
 
-        pos.make_move(move);
-        SearchResult search_result =
-            move_num == 1 ? -search_impl(pos, -beta, -alpha, depth - 1, ss + 1, sg)
-                          : -search_impl(pos, -alpha - 1, -alpha, depth - 1, ss + 1, sg);
-        if (move_num > 1 && search_result.score > alpha) {
-            search_result = -search_impl(pos, -beta, -alpha, depth - 1, ss + 1, sg);
+        table.prefetch(pos.hash());
+        int score = move_num == 1 ? -search_impl(pos, -beta, -alpha, depth - 1, ss + 1, sg)
+                                  : -search_impl(pos, -alpha - 1, -alpha, depth - 1, ss + 1, sg);
+        if (move_num > 1 && score > alpha) {
+            score = -search_impl(pos, -beta, -alpha, depth - 1, ss + 1, sg);
         }
         pos.unmake_move();
 
         if (ss->ply && sg.stop()) {
-            return {0, {}};
+            trace::record(trace::NODE_EXIT, ss->ply, depth, alpha, beta, 0, {}, tt_hit);
+            return 0;
         }
 
-        if (search_result.score > best_score) {
-            best_score = search_result.score;
+        if (score > best_score) {
+            best_score = score;
             if (best_score > alpha) {
                 alpha = best_score;
+                best_move = move;
 
                 if (pv_node) {
-                    pv.clear();
-                    pv.add(move);
-                    if (search_result.pv) {
-                        pv.add(*search_result.pv);
-                    }
+                    ss->pv.clear();
+                    ss->pv.add(move);
+                    ss->pv.add((ss + 1)->pv);
                 }
 
                 if (alpha >= beta) {
@@ -226,24 +332,24 @@ SearchResult search_impl(Position& pos, int alpha, int beta, int depth, SearchSt
         }
     }
 
+    if (!move_num) {
+        int score = in_check ? -MATE_SCORE + ss->ply : 0;
+        trace::record(trace::NODE_EXIT, ss->ply, depth, alpha, beta, score, {}, tt_hit);
+        return score;
+    }
+
     int tt_flag = best_score >= beta ? TTConstants::FLAG_LOWER
                                      : best_score < alpha ? TTConstants::FLAG_UPPER : FLAG_EXACT;
-    tt.write(pv.begin()->value(), tt_flag, depth, best_score, hash);
-    return {best_score, pv};
+    table.write(best_move.value(), tt_flag, depth, score_to_tt(best_score, ss->ply), hash);
+    trace::record(trace::NODE_EXIT, ss->ply, depth, alpha, beta, best_score, best_move, tt_hit,
+                  trace::EXIT_SEARCHED, move_num);
+    return best_score;
 }
 
 int qsearch(Position& pos) {
     auto search_stack = SearchStack::new_search_stack();
     auto search_globals = SearchGlobals::new_search_globals();
-    return qsearch_impl(pos, -INFINITE, +INFINITE, search_stack.begin(), search_globals);
-}
-
-SearchResult search(Position& pos, SearchGlobals& sg, int depth) {
-    auto search_stack = SearchStack::new_search_stack();
-    int alpha = -INFINITE;
-    int beta = +INFINITE;
-    SearchResult search_result = search_impl(pos, alpha, beta, depth, search_stack.begin(), sg);
-    return search_result;
+    return qsearch_impl(pos, -INFINITE, +INFINITE, search_stack.begin(), search_globals, true);
 }
 
 SearchResult search(Position& pos, int depth) {
@@ -252,20 +358,49 @@ SearchResult search(Position& pos, int depth) {
     auto search_globals = SearchGlobals::new_search_globals();
     int alpha = -INFINITE;
     int beta = +INFINITE;
-    SearchResult search_result =
-        search_impl(pos, alpha, beta, depth, search_stack.begin(), search_globals);
-    return search_result;
+    int score = search_impl(pos, alpha, beta, depth, search_stack.begin(), search_globals);
+    auto& pv = search_stack.front().pv;
+    return {score, pv.empty() ? std::nullopt : std::optional<MoveList>{pv}};
+}
+
+// Writes the info line straight to the output stream rather than through UCIInfoParameters,
+// which builds a map and a vector of move strings on every iteration.
+void print_info(int depth, int score, std::uint64_t time_taken, std::uint64_t nodes,
+                const MoveList& pv) {
+    std::uint64_t nps = time_taken ? nodes * 1000 / time_taken : nodes;
+    std::cout << "info depth " << depth << " score ";
+    if (score <= -MAX_MATE_SCORE) {
+        std::cout << "mate " << (-score - MATE_SCORE) / 2;
+    } else if (score >= MAX_MATE_SCORE) {
+        std::cout << "mate " << (-score + MATE_SCORE + 1) / 2;
+    } else {
+        std::cout << "cp " << score;
+    }
+    std::cout << " time " << time_taken << " nps " << nps << " nodes " << nodes << " pv";
+    for (auto move : pv) {
+        std::cout << " " << move.to_str();
+    }
+    std::cout << "\n";
 }
 
 std::optional<Move> best_move_search(Position& pos, SearchGlobals& search_globals) {
+    trace::prepare_thread();
     std::optional<Move> best_move;
     auto start_time = curr_time();
     search_globals.set_stop_flag(false);
     search_globals.set_side_to_move(pos.side_to_move());
     search_globals.reset_nodes();
     search_globals.set_start_time(start_time);
-    for (int depth = 1; depth <= MAX_PLY; ++depth) {
-        auto search_result = search(pos, search_globals, depth);
+
+    // One stack per thread, reused from search to search so its move lists keep their storage.
+    // Killers carry over between iterations but not between searches.
+    thread_local auto search_stack = SearchStack::new_search_stack();
+    for (auto& ss : search_stack) {
+        ss.killer_moves = {{std::nullopt, std::nullopt}};
+    }
+    for (int depth = 1; depth <= search_globals.depth_limit(); ++depth) {
+        int score =
+            search_impl(pos, -INFINITE, +INFINITE, depth, search_stack.begin(), search_globals);
 
         if (depth > 1 && search_globals.stop()) {
             return best_move;
@@ -273,42 +408,19 @@ std::optional<Move> best_move_search(Position& pos, SearchGlobals& search_global
 
         auto time_diff = curr_time() - start_time;
 
-        int score = search_result.score;
-        auto& pv = search_result.pv;
-        if (!pv) {
+        auto& pv = search_stack.front().pv;
+        if (pv.empty()) {
             break;
         }
 
-        best_move = *pv->begin();
+        best_move = *pv.begin();
 
-        UCIScore uci_score = [score]() {
-            if (score <= -MAX_MATE_SCORE) {
-                return UCIScore{(-score - MATE_SCORE) / 2, UCIScore::ScoreType::MATE};
-            } else if (score >= MAX_MATE_SCORE) {
-                return UCIScore{(-score + MATE_SCORE + 1) / 2, UCIScore::ScoreType::MATE};
-            } else {
-                return UCIScore{score, UCIScore::ScoreType::CENTIPAWNS};
-            }
-        }();
-
-        std::uint64_t time_taken = time_diff.count();
-        std::uint64_t nodes = search_globals.nodes();
-        std::uint64_t nps = time_taken ? nodes * 1000 / time_taken : nodes;
-        UCIInfoParameters info_parameters{{
-            {"depth", depth},
-            {"score", uci_score},
-            {"time", int(time_taken)},
-            {"nps", nps},
-            {"nodes", nodes},
-        }};
-
-        std::vector<std::string> str_move_list;
-        str_move_list.reserve(pv->size());
-        for (auto move : *pv) {
-            str_move_list.push_back(move.to_str());
+        if (search_globals.iteration_handler()) {
+            search_globals.iteration_handler()(depth, score, search_globals.nodes(), time_diff,
+                                               pv);
+        } else {
+            print_info(depth, score, time_diff.count(), search_globals.nodes(), pv);
         }
-        info_parameters.set_pv(UCIMoveList{str_move_list});
-        UCIService::info(info_parameters);
     }
 
     return best_move;
@@ -1,12 +1,19 @@
 #ifndef SEARCH_H
 #define SEARCH_H
 
+#include <algorithm>
+#include <functional>
+
 #include "libchess/Position.h"
 #include "libchess/UCIService.h"
 
+struct TranspositionTable;
+
 namespace search {
 
 static const int MAX_PLY = 128;
+// Upper bound on the pseudo-legal moves of a position, which the per-ply move lists are sized to
+static const int MAX_MOVES = 256;
 static const int INFINITE = 30001;
 static const int MATE_SCORE = 30000;
 static const int MAX_MATE_SCORE = MATE_SCORE - MAX_PLY;
@@ -20,29 +27,63 @@ struct SearchResult {
     SearchResult(int score_, std::optional<libchess::MoveList> pv_) noexcept
         : score(score_), pv(std::move(pv_)) {}
 
-    SearchResult operator-() const noexcept { return {-score, pv}; }
-
     int score;
     std::optional<libchess::MoveList> pv;
 };
 
 class SearchGlobals {
   public:
+    using IterationHandler = std::function<void(int depth, int score, std::uint64_t nodes,
+                                                std::chrono::milliseconds time,
+                                                const libchess::MoveList& pv)>;
+
     SearchGlobals(uint64_t nodes, std::optional<std::chrono::milliseconds> start_time,
                   std::optional<libchess::UCIGoParameters> go_parameters) noexcept
         : side_to_move_(libchess::constants::WHITE), stop_flag_(false), nodes_(nodes),
           start_time_(start_time), go_parameters_(std::move(go_parameters)) {}
 
     [[nodiscard]] std::uint64_t nodes() const noexcept { return nodes_; }
+    // The share of nodes() visited by quiescence search
+    [[nodiscard]] std::uint64_t qnodes() const noexcept { return qnodes_; }
     [[nodiscard]] const std::optional<libchess::UCIGoParameters>& go_parameters() const noexcept {
         return go_parameters_;
     }
 
-    void reset_nodes() noexcept { nodes_ = 0; }
+    void reset_nodes() noexcept {
+        nodes_ = 0;
+        qnodes_ = 0;
+    }
     void set_start_time(std::chrono::milliseconds start_time) noexcept { start_time_ = start_time; }
     void set_go_parameters(const libchess::UCIGoParameters& go_parameters) noexcept {
         go_parameters_ = go_parameters;
+        if (go_parameters.nodes()) {
+            node_limit_ = std::uint64_t(*go_parameters.nodes());
+        } else {
+            node_limit_.reset();
+        }
+        depth_limit_ = go_parameters.depth();
+    }
+    void set_depth_limit(std::optional<int> depth_limit) noexcept { depth_limit_ = depth_limit; }
+    [[nodiscard]] int depth_limit() const noexcept {
+        return depth_limit_ ? std::min(*depth_limit_, MAX_PLY) : MAX_PLY;
+    }
+    void set_node_limit(std::optional<std::uint64_t> node_limit) noexcept {
+        node_limit_ = node_limit;
+    }
+    void set_move_time(std::optional<std::chrono::milliseconds> move_time) noexcept {
+        move_time_ = move_time;
+    }
+    void set_iteration_handler(IterationHandler iteration_handler) {
+        iteration_handler_ = std::move(iteration_handler);
+    }
+    [[nodiscard]] const IterationHandler& iteration_handler() const noexcept {
+        return iteration_handler_;
+    }
+    // Searches without a table of their own use the global tt
+    void set_transposition_table(TranspositionTable* transposition_table) noexcept {
+        transposition_table_ = transposition_table;
     }
+    [[nodiscard]] TranspositionTable& transposition_table() const noexcept;
     void set_stop_flag(bool stop_flag) noexcept { stop_flag_ = stop_flag; }
     void set_side_to_move(libchess::Color color) noexcept { side_to_move_ = color; }
 
@@ -53,10 +94,20 @@ class SearchGlobals {
     }
 
     void increment_nodes() noexcept { ++nodes_; }
+    void increment_qnodes() noexcept { ++qnodes_; }
     [[nodiscard]] bool stop() noexcept {
         if (stop_flag_) {
             return true;
         }
+        if (node_limit_ && nodes_ >= *node_limit_) {
+            stop_flag_ = true;
+            return true;
+        }
+        if (move_time_ && !(nodes_ & 4095U) && start_time_ &&
+            curr_time() - *start_time_ >= *move_time_) {
+            stop_flag_ = true;
+            return true;
+        }
         if (!go_parameters_) {
             return false;
         }
@@ -104,13 +155,52 @@ class SearchGlobals {
     libchess::Color side_to_move_;
     std::atomic<bool> stop_flag_;
     std::atomic<std::uint64_t> nodes_;
+    std::uint64_t qnodes_ = 0;
     std::optional<std::chrono::milliseconds> start_time_;
     std::optional<libchess::UCIGoParameters> go_parameters_;
+    std::optional<std::uint64_t> node_limit_;
+    std::optional<int> depth_limit_;
+    std::optional<std::chrono::milliseconds> move_time_;
+    IterationHandler iteration_handler_;
+    TranspositionTable* transposition_table_ = nullptr;
+};
+
+struct SearchStack {
+    // One extra entry so the child of a node at MAX_PLY - 1 still has a frame to clear. The move
+    // lists are filled to capacity once and cleared, so a MoveList that keeps its storage across
+    // clear() never has to grow while searching.
+    static std::array<SearchStack, MAX_PLY + 1> new_search_stack() {
+        std::array<SearchStack, MAX_PLY + 1> search_stack{};
+        for (unsigned i = 0; i < search_stack.size(); ++i) {
+            auto& ss = search_stack[i];
+            ss.ply = int(i);
+            ss.killer_moves = {{std::nullopt, std::nullopt}};
+            for (int j = 0; j < MAX_MOVES; ++j) {
+                ss.moves.add(libchess::Move{0});
+            }
+            for (int j = 0; j < MAX_PLY; ++j) {
+                ss.pv.add(libchess::Move{0});
+            }
+            ss.moves.clear();
+            ss.pv.clear();
+        }
+        return search_stack;
+    }
+
+    std::array<std::optional<libchess::Move>, 2> killer_moves;
+    // Moves of the node at this ply, generated in place rather than returned by value
+    libchess::MoveList moves;
+    libchess::MoveList pv;
+    int ply;
 };
 
+void sort_moves(const libchess::Position& pos, libchess::MoveList& move_list, SearchStack* ss,
+                std::optional<libchess::Move> tt_move = {});
 int qsearch(libchess::Position&);
 SearchResult search(libchess::Position&, int depth);
 std::optional<libchess::Move> best_move_search(libchess::Position&, SearchGlobals& search_globals);
+void print_info(int depth, int score, std::uint64_t time_taken, std::uint64_t nodes,
+                const libchess::MoveList& pv);
 
 } // namespace search
 
@@ -0,0 +1,232 @@
+#include "testsuite.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "search.h"
+#include "tt.h"
+
+using namespace libchess;
+
+namespace testsuite {
+
+namespace {
+
+std::string trim(const std::string& str) {
+    auto begin = str.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    auto end = str.find_last_not_of(" \t\r\n");
+    return str.substr(begin, end - begin + 1);
+}
+
+bool is_solution(const Position& pos, Move move, const TestPosition& test_position) {
+    auto matches = [&](const std::string& san) { return san_matches(pos, move, san); };
+    if (std::any_of(test_position.avoid_moves.begin(), test_position.avoid_moves.end(), matches)) {
+        return false;
+    }
+    return test_position.best_moves.empty() ||
+           std::any_of(test_position.best_moves.begin(), test_position.best_moves.end(), matches);
+}
+
+// The EPD line with its acn operation replaced by the given node count
+std::string with_node_budget(const std::string& line, std::uint64_t node_budget) {
+    std::string result;
+    std::istringstream line_stream{line};
+    std::string operation;
+    while (std::getline(line_stream, operation, ';')) {
+        if (trim(operation).compare(0, 4, "acn ") != 0 && !trim(operation).empty()) {
+            result += operation + ";";
+        }
+    }
+    return result + " acn " + std::to_string(node_budget) + ";";
+}
+
+} // namespace
+
+std::optional<TestPosition> parse_epd_line(const std::string& line) {
+    std::istringstream line_stream{line};
+    std::string board, side, castling, enpassant;
+    if (!(line_stream >> board >> side >> castling >> enpassant)) {
+        return std::nullopt;
+    }
+
+    TestPosition test_position;
+    test_position.fen = board + " " + side + " " + castling + " " + enpassant + " 0 1";
+
+    std::string operation;
+    while (std::getline(line_stream, operation, ';')) {
+        std::istringstream operation_stream{trim(operation)};
+        std::string opcode;
+        operation_stream >> opcode;
+
+        std::string operand;
+        if (opcode == "bm" || opcode == "am") {
+            auto& moves = opcode == "bm" ? test_position.best_moves : test_position.avoid_moves;
+            while (operation_stream >> operand) {
+                moves.push_back(operand);
+            }
+        } else if (opcode == "id") {
+            std::getline(operation_stream, operand);
+            operand = trim(operand);
+            operand.erase(std::remove(operand.begin(), operand.end(), '"'), operand.end());
+            test_position.id = operand;
+        } else if (opcode == "acn" && operation_stream >> operand) {
+            test_position.node_budget = std::stoull(operand);
+        }
+    }
+
+    if (test_position.best_moves.empty() && test_position.avoid_moves.empty()) {
+        return std::nullopt;
+    }
+    return test_position;
+}
+
+bool san_matches(const Position& pos, Move move, std::string san) {
+    std::string move_str = move.to_str();
+    if (move_str == san) {
+        return true;
+    }
+
+    while (!san.empty() && std::string{"+#!?"}.find(san.back()) != std::string::npos) {
+        san.pop_back();
+    }
+
+    auto from_pt = pos.piece_type_on(move.from_square());
+    if (!from_pt) {
+        return false;
+    }
+
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+        char to_file = san.size() == 3 ? 'g' : 'c';
+        return *from_pt == constants::KING && move_str[0] == 'e' && move_str[2] == to_file;
+    }
+
+    san.erase(std::remove(san.begin(), san.end(), 'x'), san.end());
+    san.erase(std::remove(san.begin(), san.end(), '='), san.end());
+
+    const std::string piece_letters = "NBRQK";
+    const std::array<PieceType, 5> piece_types{
+        {constants::KNIGHT, constants::BISHOP, constants::ROOK, constants::QUEEN, constants::KING}};
+    PieceType piece_type = constants::PAWN;
+    if (!san.empty() && piece_letters.find(san.front()) != std::string::npos) {
+        piece_type = piece_types[piece_letters.find(san.front())];
+        san.erase(san.begin());
+    }
+
+    char promotion = 0;
+    if (piece_type == constants::PAWN && !san.empty() &&
+        piece_letters.find(san.back()) != std::string::npos) {
+        promotion = char(std::tolower(san.back()));
+        san.pop_back();
+    }
+
+    if (san.size() < 2 || *from_pt != piece_type ||
+        move_str.compare(2, 2, san, san.size() - 2, 2) != 0) {
+        return false;
+    }
+    if ((promotion && (move_str.size() < 5 || move_str[4] != promotion)) ||
+        (!promotion && move_str.size() > 4)) {
+        return false;
+    }
+
+    // Whatever precedes the destination disambiguates the origin by file and/or rank
+    for (std::size_t i = 0; i + 2 < san.size(); ++i) {
+        char c = san[i];
+        if ((c >= 'a' && c <= 'h' && move_str[0] != c) ||
+            (c >= '1' && c <= '8' && move_str[1] != c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int run(const std::string& path, std::optional<std::uint64_t> nodes,
+        std::optional<std::chrono::milliseconds> move_time, const std::string& record_path) {
+    std::ifstream epd_file{path};
+    if (!epd_file) {
+        std::cout << "Unable to open " << path << "\n";
+        return -1;
+    }
+    std::ofstream record_file;
+    if (!record_path.empty()) {
+        record_file.open(record_path, std::ios::trunc);
+        if (!record_file) {
+            std::cout << "Unable to open " << record_path << "\n";
+            return -1;
+        }
+    }
+
+    int total = 0;
+    int solved = 0;
+    std::uint64_t total_nodes = 0;
+    std::chrono::milliseconds total_time{0};
+    std::string line;
+    while (std::getline(epd_file, line)) {
+        auto test_position = parse_epd_line(line);
+        if (!test_position) {
+            continue;
+        }
+        auto position = Position::from_fen(test_position->fen);
+        if (!position) {
+            std::cout << "Skipping invalid position " << test_position->fen << "\n";
+            continue;
+        }
+        ++total;
+
+        // Time and nodes at the iteration from which the best move stayed correct
+        std::optional<std::pair<std::chrono::milliseconds, std::uint64_t>> solved_at;
+        const Position root = *position;
+        auto node_limit = nodes;
+        if (test_position->node_budget && record_path.empty()) {
+            node_limit = std::min(nodes.value_or(*test_position->node_budget),
+                                  *test_position->node_budget);
+        }
+        auto search_globals = search::SearchGlobals::new_search_globals();
+        search_globals.set_node_limit(node_limit);
+        search_globals.set_move_time(move_time);
+        search_globals.set_iteration_handler(
+            [&](int, int, std::uint64_t iteration_nodes, std::chrono::milliseconds time,
+                const MoveList& pv) {
+                if (!is_solution(root, *pv.begin(), *test_position)) {
+                    solved_at.reset();
+                } else if (!solved_at) {
+                    solved_at = {time, iteration_nodes};
+                }
+            });
+
+        tt.clear();
+        auto best_move = search::best_move_search(*position, search_globals);
+
+        std::string id = test_position->id.empty() ? std::to_string(total) : test_position->id;
+        bool is_solved = best_move && is_solution(root, *best_move, *test_position) && solved_at;
+        if (record_file.is_open() && is_solved) {
+            auto node_budget = std::uint64_t(std::ceil(double(solved_at->second) * RECORD_MARGIN));
+            record_file << with_node_budget(line, node_budget) << "\n";
+        } else if (record_file.is_open()) {
+            record_file << line << "\n";
+        }
+        if (is_solved) {
+            ++solved;
+            total_time += solved_at->first;
+            total_nodes += solved_at->second;
+            std::cout << id << ": solved in " << solved_at->first.count() << " ms, "
+                      << solved_at->second << " nodes\n";
+        } else {
+            std::cout << id << ": failed, played " << (best_move ? best_move->to_str() : "0000")
+                      << "\n";
+        }
+    }
+
+    std::cout << "Solved " << solved << "/" << total << ", time to solution "
+              << total_time.count() << " ms, nodes to solution " << total_nodes << "\n";
+    return total - solved;
+}
+
+} // namespace testsuite
@@ -0,0 +1,39 @@
+#ifndef TESTSUITE_H
+#define TESTSUITE_H
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "libchess/Position.h"
+
+namespace testsuite {
+
+struct TestPosition {
+    std::string fen;
+    std::string id;
+    std::vector<std::string> best_moves;
+    std::vector<std::string> avoid_moves;
+    // Node budget from the acn opcode, recorded from the nodes the engine needed to solve it
+    std::optional<std::uint64_t> node_budget;
+};
+
+std::optional<TestPosition> parse_epd_line(const std::string& line);
+bool san_matches(const libchess::Position& pos, libchess::Move move, std::string san);
+
+// Searches every position of an EPD file under a node or time budget and reports whether the
+// bm/am opcodes were satisfied, along with the time and nodes it took to settle on the solution.
+// A position with an acn opcode is searched with at most that many nodes, so a search that needs
+// more nodes to find a solution than when it was recorded fails. With a record_path, acn is
+// ignored and the file is rewritten there with acn set to RECORD_MARGIN times the nodes each
+// solved position took. Returns the number of unsolved positions, or -1 if a file cannot be
+// opened.
+inline const double RECORD_MARGIN = 1.25;
+int run(const std::string& path, std::optional<std::uint64_t> nodes,
+        std::optional<std::chrono::milliseconds> move_time, const std::string& record_path = "");
+
+} // namespace testsuite
+
+#endif // TESTSUITE_H
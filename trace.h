@@ -0,0 +1,204 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "libchess/Position.h"
+
+#include "fileformat.h"
+
+// Search tree tracing. With SEARCH_TRACE defined, search_impl and qsearch_impl record compact
+// node events into a per-thread ring buffer which can be dumped to a file and turned into text
+// with trace_convert. Without it every recording function is an empty inline and compiles away.
+// Buffers belong to a process-wide pool, so the events of a search thread can still be dumped
+// after the thread has finished; a later thread reuses the buffer and starts it afresh.
+namespace trace {
+
+#ifdef SEARCH_TRACE
+inline constexpr bool ENABLED = true;
+#else
+inline constexpr bool ENABLED = false;
+#endif
+
+enum EventType : std::uint8_t {
+    NODE_ENTER,
+    NODE_EXIT,
+    QNODE_ENTER,
+    QNODE_EXIT,
+};
+
+enum ExitReason : std::uint8_t {
+    EXIT_SEARCHED,
+    EXIT_TT_CUTOFF,
+    EXIT_PRUNED,
+    EXIT_STAND_PAT,
+};
+
+struct Event {
+    std::uint8_t type;
+    std::uint8_t ply;
+    std::uint8_t depth;
+    std::uint8_t tt_hit : 1;
+    std::uint8_t reason : 7;
+    std::int16_t alpha;
+    std::int16_t beta;
+    std::int16_t score;
+    // Move leading into the node on enter, best move on exit: from | to << 6 | promotion << 12
+    std::uint16_t move;
+    std::uint8_t move_index;
+    std::uint8_t padding[3];
+};
+static_assert(sizeof(Event) == 16, "trace::Event must stay 16 bytes");
+
+// Each thread's events are written as a header followed by num_events records
+struct FileHeader {
+    fileformat::Header format;
+    std::uint32_t thread;
+    std::uint32_t padding;
+    std::uint64_t num_events;
+};
+
+inline const char FILE_MAGIC[8] = {'L', 'C', 'E', 'T', 'R', 'A', 'C', 'E'};
+inline const std::uint32_t FILE_VERSION = 2;
+
+inline std::uint16_t encode_move(std::optional<libchess::Move> move) {
+    if (!move) {
+        return 0;
+    }
+    auto promotion = move->promotion_piece_type();
+    return std::uint16_t(move->from_square().value() | (move->to_square().value() << 6U) |
+                         ((promotion ? promotion->value() + 1 : 0) << 12U));
+}
+
+#ifdef SEARCH_TRACE
+// Single-producer ring buffer: only its own thread writes to it, so recording needs no locking.
+// Dumping reads it without synchronisation and is meant to be done while the search is idle.
+class RingBuffer {
+  public:
+    static const std::size_t CAPACITY = 1U << 20U;
+
+    RingBuffer() : events_(CAPACITY) {}
+
+    // Hands out a buffer no running thread owns, allocating one only when all are taken
+    static RingBuffer& acquire() {
+        std::lock_guard<std::mutex> lock{registry_mutex()};
+        auto& buffers = registry();
+        auto free_buffer = std::find_if(buffers.begin(), buffers.end(),
+                                        [](const auto& buffer) { return !buffer->in_use_; });
+        if (free_buffer == buffers.end()) {
+            buffers.push_back(std::make_unique<RingBuffer>());
+            free_buffer = std::prev(buffers.end());
+        }
+        RingBuffer& buffer = **free_buffer;
+        buffer.in_use_ = true;
+        buffer.head_ = 0;
+        return buffer;
+    }
+    // Keeps the events for dump() until another thread acquires the buffer
+    static void release(RingBuffer& buffer) {
+        std::lock_guard<std::mutex> lock{registry_mutex()};
+        buffer.in_use_ = false;
+    }
+
+    void push(const Event& event) noexcept { events_[head_++ & (CAPACITY - 1)] = event; }
+
+    void write(std::ofstream& out, std::uint32_t thread) const {
+        std::uint64_t count = std::min<std::uint64_t>(head_, CAPACITY);
+        FileHeader header{};
+        header.format = fileformat::make_header(FILE_MAGIC, FILE_VERSION, sizeof(Event));
+        header.thread = thread;
+        header.num_events = count;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (std::uint64_t i = head_ - count; i < head_; ++i) {
+            out.write(reinterpret_cast<const char*>(&events_[i & (CAPACITY - 1)]), sizeof(Event));
+        }
+    }
+
+    static std::mutex& registry_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+    static std::vector<std::unique_ptr<RingBuffer>>& registry() {
+        static std::vector<std::unique_ptr<RingBuffer>> buffers;
+        return buffers;
+    }
+
+  private:
+    std::vector<Event> events_;
+    std::uint64_t head_ = 0;
+    bool in_use_ = false;
+};
+
+// Holds a pooled buffer for the lifetime of a thread
+class BufferLease {
+  public:
+    BufferLease() : buffer_(RingBuffer::acquire()) {}
+    ~BufferLease() { RingBuffer::release(buffer_); }
+    BufferLease(const BufferLease&) = delete;
+    BufferLease& operator=(const BufferLease&) = delete;
+
+    RingBuffer& buffer() noexcept { return buffer_; }
+
+  private:
+    RingBuffer& buffer_;
+};
+
+inline RingBuffer& local_buffer() {
+    thread_local BufferLease lease;
+    return lease.buffer();
+}
+
+inline bool dump(const std::string& path) {
+    std::ofstream out{path, std::ios::binary | std::ios::trunc};
+    if (!out) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock{RingBuffer::registry_mutex()};
+    std::uint32_t thread = 0;
+    for (auto& buffer : RingBuffer::registry()) {
+        buffer->write(out, thread++);
+    }
+    return bool(out);
+}
+#endif
+
+// Acquires the calling thread's buffer up front so its allocation is not charged to the search
+inline void prepare_thread() {
+#ifdef SEARCH_TRACE
+    local_buffer();
+#endif
+}
+
+inline void record(EventType type, int ply, int depth, int alpha, int beta, int score,
+                   std::optional<libchess::Move> move, bool tt_hit = false,
+                   ExitReason reason = EXIT_SEARCHED, int move_index = 0) {
+#ifdef SEARCH_TRACE
+    Event event{};
+    event.type = type;
+    event.ply = std::uint8_t(ply);
+    event.depth = std::uint8_t(std::clamp(depth, 0, 255));
+    event.tt_hit = tt_hit;
+    event.reason = reason;
+    event.alpha = std::int16_t(alpha);
+    event.beta = std::int16_t(beta);
+    event.score = std::int16_t(score);
+    event.move = encode_move(move);
+    event.move_index = std::uint8_t(std::min(move_index, 255));
+    local_buffer().push(event);
+#else
+    (void)type, (void)ply, (void)depth, (void)alpha, (void)beta, (void)score, (void)move,
+        (void)tt_hit, (void)reason, (void)move_index;
+#endif
+}
+
+} // namespace trace
+
+#endif // TRACE_H
@@ -0,0 +1,132 @@
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "fileformat.h"
+#include "trace.h"
+
+// Turns a file written by the engine's tracedump command into either an indented search tree or
+// folded stacks ("root;e2e4;e7e5 <nodes>") that flame graph tools accept.
+
+namespace {
+
+std::string move_str(std::uint16_t move) {
+    if (!move) {
+        return "root";
+    }
+    int from = move & 63U;
+    int to = (move >> 6U) & 63U;
+    int promotion = move >> 12U;
+    std::string str{char('a' + from % 8), char('1' + from / 8), char('a' + to % 8),
+                    char('1' + to / 8)};
+    if (promotion) {
+        str += " pnbrqk"[promotion];
+    }
+    return str;
+}
+
+const char* exit_reason_str(int reason) {
+    switch (reason) {
+    case trace::EXIT_TT_CUTOFF:
+        return "tt cutoff";
+    case trace::EXIT_PRUNED:
+        return "pruned";
+    case trace::EXIT_STAND_PAT:
+        return "stand pat";
+    default:
+        return "searched";
+    }
+}
+
+void print_tree(const std::vector<trace::Event>& events, int max_ply) {
+    for (auto& event : events) {
+        if (event.ply > max_ply) {
+            continue;
+        }
+        std::string indent(2U * event.ply, ' ');
+        bool qnode = event.type == trace::QNODE_ENTER || event.type == trace::QNODE_EXIT;
+        if (event.type == trace::NODE_ENTER || event.type == trace::QNODE_ENTER) {
+            std::cout << indent << move_str(event.move) << (qnode ? " qs" : "")
+                      << " depth " << int(event.depth) << " window [" << event.alpha << ", "
+                      << event.beta << "]" << (event.tt_hit ? " tt hit" : "") << "\n";
+        } else {
+            std::cout << indent << "= " << event.score << " " << exit_reason_str(event.reason);
+            if (event.move) {
+                std::cout << " best " << move_str(event.move) << " after "
+                          << int(event.move_index) << " moves";
+            }
+            std::cout << "\n";
+        }
+    }
+}
+
+// Counts every node entered under the stack of moves leading to it
+void fold_stacks(const std::vector<trace::Event>& events, std::uint32_t thread,
+                 std::map<std::string, std::uint64_t>& stacks) {
+    std::vector<std::string> path{"thread" + std::to_string(thread)};
+    for (auto& event : events) {
+        if (event.type == trace::NODE_ENTER || event.type == trace::QNODE_ENTER) {
+            // The ring buffer may have wrapped, so the oldest events can be exits from nodes
+            // whose entries were overwritten; a new root resets the path
+            if (event.ply == 0) {
+                path.resize(1);
+            }
+            path.push_back(event.ply == 0 ? "root" : move_str(event.move));
+            std::string stack = path.front();
+            for (std::size_t i = 1; i < path.size(); ++i) {
+                stack += ";" + path[i];
+            }
+            ++stacks[stack];
+        } else if (path.size() > 1) {
+            path.pop_back();
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <trace file> [tree|folded] [max ply]\n";
+        return 1;
+    }
+    std::string mode = argc > 2 ? argv[2] : "tree";
+    int max_ply = argc > 3 ? std::stoi(argv[3]) : 255;
+
+    std::ifstream in{argv[1], std::ios::binary};
+    if (!in) {
+        std::cerr << "Unable to open " << argv[1] << "\n";
+        return 1;
+    }
+
+    std::map<std::string, std::uint64_t> stacks;
+    trace::FileHeader header{};
+    while (in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        if (!fileformat::is_valid_header(header.format, trace::FILE_MAGIC, trace::FILE_VERSION,
+                                         sizeof(trace::Event))) {
+            std::cerr << "Not a search trace: " << argv[1] << "\n";
+            return 1;
+        }
+        std::vector<trace::Event> events(header.num_events);
+        if (!in.read(reinterpret_cast<char*>(events.data()),
+                     std::streamsize(events.size() * sizeof(trace::Event)))) {
+            std::cerr << "Truncated trace: " << argv[1] << "\n";
+            return 1;
+        }
+
+        if (mode == "folded") {
+            fold_stacks(events, header.thread, stacks);
+        } else {
+            std::cout << "thread " << header.thread << ": " << header.num_events << " events\n";
+            print_tree(events, max_ply);
+        }
+    }
+
+    for (auto& [stack, count] : stacks) {
+        std::cout << stack << " " << count << "\n";
+    }
+    return 0;
+}
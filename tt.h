@@ -25,8 +25,18 @@ SOFTWARE.
 #ifndef TT_H
 #define TT_H
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <cinttypes>
+#include <cstring>
+#include <fstream>
 #include <memory>
+#include <string>
+
+#include "fileformat.h"
 
 enum TTConstants {
     FLAG_EXACT = 1,
@@ -73,7 +83,8 @@ inline int TTEntry::get_depth() const { return (data >> DEPTH_SHIFT) & DEPTH_MAS
 inline int TTEntry::get_score() const { return int(data >> SCORE_SHIFT); }
 inline void TTEntry::clear() { key = data = 0; }
 
-struct TTCluster {
+struct alignas(64) TTCluster {
+    TTEntry probe(std::uint64_t key) const;
     TTEntry& get_entry(std::uint64_t key);
     void clear();
 
@@ -81,6 +92,16 @@ struct TTCluster {
     TTEntry entries[CLUSTER_SIZE];
 };
 
+inline TTEntry TTCluster::probe(std::uint64_t key) const {
+    for (const TTEntry& entry : entries) {
+        if (entry.get_key() == key)
+            return entry;
+    }
+    TTEntry empty;
+    empty.clear();
+    return empty;
+}
+
 inline TTEntry& TTCluster::get_entry(std::uint64_t key) {
     // If any entry key matches, return it
     for (TTEntry& entry : entries) {
@@ -101,44 +122,101 @@ inline void TTCluster::clear() {
         entry.clear();
 }
 
+static_assert(sizeof(TTCluster) == 64, "TTCluster must fill one cache line");
+
+// Header written in front of the cluster array by save() and the mapped tables. It is 64 bytes so
+// the clusters that follow it in a mapped file keep their alignment.
+struct TTFileHeader {
+    // format.record_size is sizeof(TTCluster)
+    fileformat::Header format;
+    std::uint64_t num_clusters;
+    char reserved[32];
+};
+static_assert(sizeof(TTFileHeader) == 64, "TTFileHeader must be 64 bytes");
+
+inline const char TT_FILE_MAGIC[8] = {'L', 'C', 'E', 'H', 'A', 'S', 'H', '\0'};
+inline const std::uint32_t TT_FILE_VERSION = 2;
+
+inline TTFileHeader make_tt_file_header(int num_clusters) {
+    TTFileHeader header{};
+    header.format = fileformat::make_header(TT_FILE_MAGIC, TT_FILE_VERSION, sizeof(TTCluster));
+    header.num_clusters = std::uint64_t(num_clusters);
+    return header;
+}
+
+inline bool is_valid_tt_file_header(const TTFileHeader& header) {
+    return fileformat::is_valid_header(header.format, TT_FILE_MAGIC, TT_FILE_VERSION,
+                                       sizeof(TTCluster)) &&
+           header.num_clusters > 0 && header.num_clusters <= std::uint64_t(INT32_MAX);
+}
+
+// Size of a saved or mapped table, which a header is only trusted to describe if it matches
+inline std::uint64_t tt_file_length(const TTFileHeader& header) {
+    return sizeof(TTFileHeader) + sizeof(TTCluster) * header.num_clusters;
+}
+
 struct TranspositionTable {
     TranspositionTable();
     ~TranspositionTable();
     TranspositionTable(int MB);
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
     void resize(int MB);
     TTEntry probe(std::uint64_t key) const;
+    void prefetch(std::uint64_t key) const;
     void write(std::uint64_t move, std::uint64_t flag, std::uint64_t depth, std::uint64_t score,
                std::uint64_t key);
     void clear();
     int hash(std::uint64_t key) const;
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+    bool map_file(const std::string& path, int MB);
+    bool map_shared(const std::string& name, int MB);
+    static bool unlink_shared(const std::string& name);
 
   private:
-    TTCluster* table;
-    int size;
+    bool map_fd(int fd, int MB);
+    void allocate(int clusters);
+    void release();
+
+    TTCluster* table = nullptr;
+    int size = 0;
+    void* mapping = nullptr;
+    std::size_t mapping_length = 0;
 };
 
 inline TranspositionTable::TranspositionTable() {
-    size = (1 << 20) / sizeof(TTCluster);
-    table = new TTCluster[size];
+    allocate((1 << 20) / sizeof(TTCluster));
     clear();
 }
 
-inline TranspositionTable::~TranspositionTable() {
-    if (table != nullptr) {
+inline TranspositionTable::~TranspositionTable() { release(); }
+
+inline TranspositionTable::TranspositionTable(int MB) { resize(MB); }
+
+inline void TranspositionTable::allocate(int clusters) {
+    release();
+    size = clusters;
+    table = new TTCluster[size];
+}
+
+inline void TranspositionTable::release() {
+    if (mapping != nullptr) {
+        munmap(mapping, mapping_length);
+    } else {
         delete[] table;
     }
     table = nullptr;
+    mapping = nullptr;
+    mapping_length = 0;
+    size = 0;
 }
 
-inline TranspositionTable::TranspositionTable(int MB) { resize(MB); }
-
 inline void TranspositionTable::resize(int MB) {
     if (MB <= 0)
         MB = 1;
 
-    size = ((1 << 20) / sizeof(TTCluster)) * MB;
-    delete[] table;
-    table = new TTCluster[size];
+    allocate(((1 << 20) / sizeof(TTCluster)) * MB);
     clear();
 }
 
@@ -151,7 +229,11 @@ inline int TranspositionTable::hash(std::uint64_t key) const { return key % size
 
 inline TTEntry TranspositionTable::probe(std::uint64_t key) const {
     int index = hash(key);
-    return table[index].get_entry(key);
+    return table[index].probe(key);
+}
+
+inline void TranspositionTable::prefetch(std::uint64_t key) const {
+    __builtin_prefetch(&table[hash(key)]);
 }
 
 inline void TranspositionTable::write(std::uint64_t move, std::uint64_t flag, std::uint64_t depth,
@@ -160,6 +242,116 @@ inline void TranspositionTable::write(std::uint64_t move, std::uint64_t flag, st
     table[index].get_entry(key).set(move, flag, depth, score, key);
 }
 
+inline bool TranspositionTable::save(const std::string& path) const {
+    std::ofstream out{path, std::ios::binary | std::ios::trunc};
+    if (!out) {
+        return false;
+    }
+    TTFileHeader header = make_tt_file_header(size);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(table), std::streamsize(sizeof(TTCluster)) * size);
+    return bool(out);
+}
+
+inline bool TranspositionTable::load(const std::string& path) {
+    std::ifstream in{path, std::ios::binary};
+    if (!in) {
+        return false;
+    }
+    TTFileHeader header{};
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        !is_valid_tt_file_header(header)) {
+        return false;
+    }
+    // A truncated or corrupt file is rejected before the current table is released
+    in.seekg(0, std::ios::end);
+    if (std::uint64_t(in.tellg()) != tt_file_length(header)) {
+        return false;
+    }
+    in.seekg(sizeof(header));
+    allocate(int(header.num_clusters));
+    if (!in.read(reinterpret_cast<char*>(table), std::streamsize(sizeof(TTCluster)) * size)) {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+// Maps an open file descriptor as the backing store of the table. Memory that already holds a
+// table of the size its header describes is reused, otherwise it is initialised with MB megabytes
+// of clusters.
+inline bool TranspositionTable::map_fd(int fd, int MB) {
+    struct stat file_stat {};
+    if (fstat(fd, &file_stat) < 0) {
+        return false;
+    }
+    TTFileHeader header{};
+    bool reuse = pread(fd, &header, sizeof(header), 0) == ssize_t(sizeof(header)) &&
+                 is_valid_tt_file_header(header) &&
+                 std::uint64_t(file_stat.st_size) == tt_file_length(header);
+    if (!reuse) {
+        if (MB <= 0)
+            MB = 1;
+        header = make_tt_file_header(((1 << 20) / sizeof(TTCluster)) * MB);
+    }
+
+    std::size_t length = tt_file_length(header);
+    if (std::size_t(file_stat.st_size) != length && ftruncate(fd, off_t(length)) < 0) {
+        return false;
+    }
+
+    void* base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+
+    release();
+    mapping = base;
+    mapping_length = length;
+    size = int(header.num_clusters);
+    table = reinterpret_cast<TTCluster*>(static_cast<char*>(base) + sizeof(TTFileHeader));
+    if (!reuse) {
+        clear();
+        std::memcpy(base, &header, sizeof(header));
+    }
+    return true;
+}
+
+// Uses a file as the table so an interrupted analysis can be resumed from it.
+inline bool TranspositionTable::map_file(const std::string& path, int MB) {
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool mapped = map_fd(fd, MB);
+    close(fd);
+    return mapped;
+}
+
+inline std::string shared_table_name(const std::string& name) {
+    return name.front() == '/' ? name : "/" + name;
+}
+
+// Uses a named POSIX shared memory segment as the table so several engine processes on a host
+// search with one table. Entries stay consistent through the XOR key validation in TTEntry. The
+// segment outlives the processes using it, keeping its contents and size, until it is removed
+// with unlink_shared() or the host restarts.
+inline bool TranspositionTable::map_shared(const std::string& name, int MB) {
+    int fd = shm_open(shared_table_name(name).c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool mapped = map_fd(fd, MB);
+    close(fd);
+    return mapped;
+}
+
+// Removes a shared table. Processes that have it mapped keep using their mapping, and the memory
+// is freed once the last of them unmaps it.
+inline bool TranspositionTable::unlink_shared(const std::string& name) {
+    return shm_unlink(shared_table_name(name).c_str()) == 0;
+}
+
 inline TranspositionTable tt(128);
 
 #endif